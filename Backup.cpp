@@ -52,6 +52,14 @@ TBackup::TFileMapping::TFileMapping(string _fileName, string _bakFileName)
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 
+TBackup::TMemoryCopy::TMemoryCopy(const string& _fileName)
+    : fileName(_fileName)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
 const char* const TBackup::bakFileSuffix = ".bak";
 
 //------------------------------------------------------------------------------
@@ -74,7 +82,12 @@ string TBackup::backupFileName(const string& fileName)
 //------------------------------------------------------------------------------
 
 TBackup::TBackup()
-    : m_SkipBackup(false)
+    : m_MemoryLimit(0),
+      m_MemorySize(0),
+      m_pArchive(NULL),
+      m_pJournal(NULL),
+      m_pCheckpoint(NULL),
+      m_SkipBackup(false)
 {
 }
 
@@ -82,17 +95,76 @@ TBackup::TBackup()
 
 TBackup::~TBackup()
 {
-    restore();
+    // If files can't be restored, checkpoint is kept for rollback.
+    if (!restore() && m_pCheckpoint != NULL)
+        m_pCheckpoint->close();
+    closeArchive();
+    closeJournal();
+}
+
+//------------------------------------------------------------------------------
+
+void TBackup::closeArchive()
+{
+    delete m_pArchive;
+    m_pArchive = NULL;
+}
+
+//------------------------------------------------------------------------------
+
+void TBackup::closeJournal()
+{
+    delete m_pJournal;
+    m_pJournal = NULL;
+}
+
+//------------------------------------------------------------------------------
+// Keeping copy of file in memory. Returns false if file doesn't fit into
+// limit of memory; then file is backed up on disk.
+
+bool TBackup::backupToMemory(const string& fileName)
+{
+    uint64_t Size = 0, Time = 0;
+    if (!getFileInfo(fileName, &Size, &Time) || Size > m_MemoryLimit - m_MemorySize)
+        return false;
+
+    m_MemoryCopies.push_back(TMemoryCopy(fileName));
+    if (!readFile(fileName, &m_MemoryCopies.back().data)) {
+        m_MemoryCopies.pop_back();
+        return false;
+    }
+    LOG_V("Keeping copy of file \"%s\" in memory.\n", fileName.c_str());
+    m_MemorySize += Size;
+    return true;
 }
 
 //------------------------------------------------------------------------------
 
 bool TBackup::backupFile(const string& fileName, const TBackupMethod method)
 {
+    // Backup of file may be made by interrupted run.
+    if (m_BackedUp.count(fileName) != 0)
+        return true;
+
     if (isFileExists(fileName))
     {
         if (!m_SkipBackup)
         {
+            // Copies are stored in archive, if it is used. With journal
+            // files are not copied: changed parts are journaled by patcher.
+            if (m_pJournal != NULL && method == bmCopy)
+                return true;
+            if (method == bmCopy && backupToMemory(fileName)) {
+                m_BackedUp.insert(fileName);
+                return m_pCheckpoint == NULL || m_pCheckpoint->addMemoryBackup(fileName);
+            }
+            if (m_pArchive != NULL && method != bmRename) {
+                if (!m_pArchive->add(fileName))
+                    return false;
+                m_BackedUp.insert(fileName);
+                return m_pCheckpoint == NULL || m_pCheckpoint->addBackup(fileName, string());
+            }
+
             string BakFileName = backupFileName(fileName);
             switch (method)
             {
@@ -104,8 +176,16 @@ bool TBackup::backupFile(const string& fileName, const TBackupMethod method)
                     if (!renameFile(fileName, BakFileName))
                         return false;
                     break;
+                case bmLink :
+                    // Copying if file system doesn't support hard links.
+                    if (!linkFile(fileName, BakFileName) && !copyFile(fileName, BakFileName))
+                        return false;
+                    break;
             }
             m_FilesMapping.push_back(TFileMapping(fileName, BakFileName));
+            m_BackedUp.insert(fileName);
+            if (m_pCheckpoint != NULL && !m_pCheckpoint->addBackup(fileName, BakFileName))
+                return false;
         }
         else {
             if (method == bmRename && !removeFile(fileName))
@@ -122,16 +202,18 @@ bool TBackup::backupFile(const string& fileName, const TBackupMethod method)
 }
 
 //------------------------------------------------------------------------------
+// Records of backups are synced to checkpoint once for the list: files are
+// changed only after it.
 
 bool TBackup::backupFiles(const TStringList& files, const TBackupMethod method)
 {
-    if (m_SkipBackup && method == bmCopy)
+    if (m_SkipBackup && method != bmRename)
         return true;
 
     for (TStringList::const_iterator Iter = files.begin(); Iter != files.end(); ++Iter)
         if (!backupFile(*Iter, method))
             return false;
-    return true;
+    return m_pCheckpoint == NULL || m_pCheckpoint->sync();
 }
 
 //------------------------------------------------------------------------------
@@ -139,6 +221,19 @@ bool TBackup::backupFiles(const TStringList& files, const TBackupMethod method)
 bool TBackup::remove()
 {
     bool Result = true;
+    m_MemoryCopies.clear();
+    m_MemorySize = 0;
+    if (m_pArchive != NULL) {
+        LOG_V("\nRemoving backup archive.\n");
+        Result = m_pArchive->remove();
+        closeArchive();
+    }
+    if (m_pJournal != NULL) {
+        LOG_V("\nRemoving backup journal.\n");
+        if (!m_pJournal->remove())
+            Result = false;
+        closeJournal();
+    }
     if (!m_FilesMapping.empty()) {
         LOG_V("\nCleaning backup list.\n");
         for (TFilesMapping::const_iterator Iter = m_FilesMapping.begin(); Iter != m_FilesMapping.end(); ++Iter)
@@ -154,6 +249,24 @@ bool TBackup::remove()
 bool TBackup::restore()
 {
     bool Result = true;
+    if (!m_MemoryCopies.empty()) {
+        LOG_V("\nRestoring files from memory.\n");
+        for (TMemoryCopies::const_iterator Iter = m_MemoryCopies.begin(); Iter != m_MemoryCopies.end(); ++Iter)
+            if (!writeFileAtomic(Iter->fileName, Iter->data.data(), Iter->data.size()))
+                Result = false;
+        m_MemoryCopies.clear();
+        m_MemorySize = 0;
+    }
+    if (m_pArchive != NULL) {
+        if (!m_pArchive->restore() || !m_pArchive->remove())
+            Result = false;
+        closeArchive();
+    }
+    if (m_pJournal != NULL) {
+        if (!m_pJournal->restore() || !m_pJournal->remove())
+            Result = false;
+        closeJournal();
+    }
     if (!m_FilesMapping.empty()) {
         LOG_V("\nRestoring backup.\n");
         for (TFilesMapping::const_iterator Iter = m_FilesMapping.begin(); Iter != m_FilesMapping.end(); ++Iter)
@@ -164,11 +277,59 @@ bool TBackup::restore()
     return Result;
 }
 
+//------------------------------------------------------------------------------
+// Restoring of some files from backup before they are patched again. Backup
+// stays: ".bak" files are copied back.
+
+bool TBackup::restoreFiles(const TStringList& files)
+{
+    const TStringSet FileNames(files.begin(), files.end());
+    bool Result = true;
+    if (m_pArchive != NULL && !m_pArchive->restoreFiles(FileNames))
+        Result = false;
+    if (m_pJournal != NULL && !m_pJournal->restoreFiles(FileNames))
+        Result = false;
+    for (TFilesMapping::const_iterator Iter = m_FilesMapping.begin(); Iter != m_FilesMapping.end(); ++Iter)
+        if (FileNames.count(Iter->fileName) != 0) {
+            // File may be hard link to backup, so it is removed before copying.
+            if (!removeFile(Iter->fileName) || !copyFile(Iter->bakFileName, Iter->fileName))
+                Result = false;
+        }
+    return Result;
+}
+
 //------------------------------------------------------------------------------
 
-void TBackup::save()
+bool TBackup::save()
 {
+    bool Result = true;
+
+    // Copies from memory are written into archive or ".bak" files.
+    for (TMemoryCopies::const_iterator Iter = m_MemoryCopies.begin(); Iter != m_MemoryCopies.end(); ++Iter) {
+        if (m_pArchive != NULL) {
+            if (!m_pArchive->add(Iter->fileName, Iter->data))
+                Result = false;
+        }
+        else if (!writeFileAtomic(backupFileName(Iter->fileName), Iter->data.data(), Iter->data.size())) {
+            Result = false;
+        }
+    }
+    m_MemoryCopies.clear();
+    m_MemorySize = 0;
+
+    if (m_pArchive != NULL) {
+        if (!m_pArchive->close())
+            Result = false;
+        closeArchive();
+    }
+    if (m_pJournal != NULL) {
+        if (!m_pJournal->close())
+            Result = false;
+        closeJournal();
+    }
     m_FilesMapping.clear();
+
+    return Result;
 }
 
 //------------------------------------------------------------------------------
@@ -181,3 +342,82 @@ void TBackup::setSkipBackup(bool skipBackup)
 }
 
 //------------------------------------------------------------------------------
+// Copies of files will be stored in one archive instead of ".bak" files.
+
+bool TBackup::setArchive(const string& fileName)
+{
+    closeArchive();
+    m_pArchive = new TBackupArchive(fileName);
+    if (!m_pArchive->create()) {
+        closeArchive();
+        return false;
+    }
+    return m_pCheckpoint == NULL || m_pCheckpoint->addArchive(fileName);
+}
+
+//------------------------------------------------------------------------------
+// Original parts of changed files will be stored in journal instead of
+// copies of files.
+
+bool TBackup::setJournal(const string& fileName)
+{
+    closeJournal();
+    m_pJournal = new TBackupJournal(fileName);
+    if (!m_pJournal->create()) {
+        closeJournal();
+        return false;
+    }
+    return m_pCheckpoint == NULL || m_pCheckpoint->addJournal(fileName);
+}
+
+//------------------------------------------------------------------------------
+// Backups and backup files will be recorded in checkpoint.
+
+void TBackup::setCheckpoint(TCheckpoint* pCheckpoint)
+{
+    m_pCheckpoint = pCheckpoint;
+}
+
+//------------------------------------------------------------------------------
+// Files up to limit of memory (in bytes) are backed up in memory. Zero
+// limit turns it off.
+
+void TBackup::setMemoryLimit(uint64_t memoryLimit)
+{
+    m_MemoryLimit = memoryLimit;
+    if (m_MemoryLimit > 0)
+        LOG_V("Backup in memory up to %llu bytes.\n", static_cast<unsigned long long>(m_MemoryLimit));
+}
+
+//------------------------------------------------------------------------------
+// Taking backup made by interrupted run from its checkpoint.
+
+bool TBackup::resume(const TCheckpoint& checkpoint)
+{
+    if (!checkpoint.archiveName().empty()) {
+        closeArchive();
+        m_pArchive = new TBackupArchive(checkpoint.archiveName());
+        if (!m_pArchive->open()) {
+            closeArchive();
+            return false;
+        }
+    }
+    if (!checkpoint.journalName().empty()) {
+        closeJournal();
+        m_pJournal = new TBackupJournal(checkpoint.journalName());
+        if (!m_pJournal->open()) {
+            closeJournal();
+            return false;
+        }
+    }
+
+    const TStringMap& Backups = checkpoint.backups();
+    for (TStringMap::const_iterator Iter = Backups.begin(); Iter != Backups.end(); ++Iter) {
+        m_BackedUp.insert(Iter->first);
+        if (!Iter->second.empty())
+            m_FilesMapping.push_back(TFileMapping(Iter->first, Iter->second));
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
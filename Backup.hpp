@@ -34,7 +34,12 @@
 
 //------------------------------------------------------------------------------
 
+#include <stdint.h>
+
 #include "CommonTypes.hpp"
+#include "BackupArchive.hpp"
+#include "BackupJournal.hpp"
+#include "Checkpoint.hpp"
 
 //------------------------------------------------------------------------------
 
@@ -49,17 +54,39 @@ class TBackup
         };
         typedef std::list<TFileMapping> TFilesMapping;
 
+        struct TMemoryCopy {
+            std::string       fileName;
+            std::vector<char> data;
+
+            TMemoryCopy(const std::string& _fileName);
+        };
+        typedef std::list<TMemoryCopy> TMemoryCopies;
+
         static const char* const bakFileSuffix;
 
-        TFilesMapping m_FilesMapping;
-        bool          m_SkipBackup;
+        TFilesMapping   m_FilesMapping;
+        TMemoryCopies   m_MemoryCopies;
+        uint64_t        m_MemoryLimit;
+        uint64_t        m_MemorySize;
+        TStringSet      m_BackedUp;
+        TBackupArchive* m_pArchive;
+        TBackupJournal* m_pJournal;
+        TCheckpoint*    m_pCheckpoint;
+        bool            m_SkipBackup;
+
+        TBackup(const TBackup&);
+        TBackup& operator=(const TBackup&);
 
         static std::string backupFileName(const std::string& fileName);
+        bool backupToMemory(const std::string& fileName);
+        void closeArchive();
+        void closeJournal();
 
     public :
         enum TBackupMethod {
             bmCopy,
-            bmRename
+            bmRename,
+            bmLink     // File must be replaced later, not changed in place.
         };
 
         TBackup();
@@ -69,10 +96,17 @@ class TBackup
         bool backupFiles(const TStringList& files, const TBackupMethod method = bmCopy);
         bool remove();
         bool restore();
-        void save();
+        bool restoreFiles(const TStringList& files);
+        bool save();
         void setSkipBackup(bool skipBackup);
+        bool setArchive(const std::string& fileName);
+        bool setJournal(const std::string& fileName);
+        void setCheckpoint(TCheckpoint* pCheckpoint);
+        void setMemoryLimit(uint64_t memoryLimit);
+        bool resume(const TCheckpoint& checkpoint);
 
         inline bool skipBackup() const { return m_SkipBackup; }
+        inline TBackupJournal* journal() const { return m_pJournal; }
 };
 
 //------------------------------------------------------------------------------
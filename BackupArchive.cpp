@@ -0,0 +1,373 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "BackupArchive.hpp"
+
+#include <string.h>
+#include <errno.h>
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char         ArchiveSignature[] = "QtBinPatcher backup archive 1\n";
+static const size_t       CopyBufferSize     = 1024 * 32;
+static const unsigned int MaxNameLength      = 65536;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TBackupArchive::TEntry::TEntry(const string& fileName, uint64_t offset, uint64_t size, uint64_t hash)
+    : FileName(fileName), Offset(offset), Size(size), Hash(hash)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TBackupArchive::TBackupArchive(const string& fileName)
+    : m_FileName(fileName),
+      m_File(NULL),
+      m_ReadOnly(false),
+      m_Size(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TBackupArchive::~TBackupArchive()
+{
+    if (m_File != NULL)
+        fclose(m_File);
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::write(const void* data, size_t size)
+{
+    if (size > 0 && fwrite(data, size, 1, m_File) != 1) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    m_Size += size;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Record of file: "<tag> <data offset> <size> <hash> <name length> <name>".
+// Archive begins with signature, so data never has zero offset.
+
+bool TBackupArchive::writeEntry(const char* tag, const TEntry& entry)
+{
+    char Buffer[128];
+    const int Length = sprintf(Buffer, "%s %llu %llu %016llx %u ", tag,
+                               static_cast<unsigned long long>(entry.Offset),
+                               static_cast<unsigned long long>(entry.Size),
+                               static_cast<unsigned long long>(entry.Hash),
+                               static_cast<unsigned int>(entry.FileName.length()));
+    return write(Buffer, Length) &&
+           write(entry.FileName.data(), entry.FileName.length()) &&
+           write("\n", 1);
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::isSameData(uint64_t offset, const vector<char>& data)
+{
+    if (!Functions::seekFile(m_File, offset))
+        return false;
+
+    char Buffer[CopyBufferSize];
+    bool Result = true;
+    for (size_t Pos = 0; Result && Pos < data.size(); Pos += sizeof(Buffer)) {
+        const size_t Size = data.size() - Pos < sizeof(Buffer) ? data.size() - Pos : sizeof(Buffer);
+        Result = fread(Buffer, Size, 1, m_File) == 1 && memcmp(Buffer, data.data() + Pos, Size) == 0;
+    }
+    Functions::seekFile(m_File, m_Size);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Searching for the same data stored before. Data with equal hash and size
+// are compared byte by byte.
+
+bool TBackupArchive::findData(uint64_t hash, const vector<char>& data, uint64_t* pOffset)
+{
+    typedef pair<TDataMap::const_iterator, TDataMap::const_iterator> TRange;
+    const TRange Range = m_Data.equal_range(make_pair(hash, static_cast<uint64_t>(data.size())));
+    for (TDataMap::const_iterator Iter = Range.first; Iter != Range.second; ++Iter)
+        if (isSameData(Iter->second, data)) {
+            *pOffset = Iter->second;
+            return true;
+        }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::create()
+{
+    LOG_V("Creating backup archive \"%s\".\n", m_FileName.c_str());
+
+    m_File = fopen(m_FileName.c_str(), "w+b");
+    if (m_File == NULL) {
+        LOG_E("Error opening file \"%s\" for writing. Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    m_ReadOnly = false;
+    m_Entries.clear();
+    m_Data.clear();
+    m_Size = 0;
+    return write(ArchiveSignature, sizeof(ArchiveSignature) - 1);
+}
+
+//------------------------------------------------------------------------------
+// Opening archive left by interrupted run. Records of files are read up to
+// index or incomplete last record, which is cut off; new files are appended.
+// Read-only archive is not changed.
+
+bool TBackupArchive::open(bool readOnly)
+{
+    LOG_V("Opening backup archive \"%s\".\n", m_FileName.c_str());
+
+    m_File = fopen(m_FileName.c_str(), readOnly ? "rb" : "r+b");
+    if (m_File == NULL) {
+        LOG_E("Error opening file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+
+    char Signature[sizeof(ArchiveSignature) - 1];
+    if (fread(Signature, sizeof(Signature), 1, m_File) != 1 ||
+        memcmp(Signature, ArchiveSignature, sizeof(Signature)) != 0)
+    {
+        LOG_E("File \"%s\" is not a backup archive.\n", m_FileName.c_str());
+        fclose(m_File);
+        m_File = NULL;
+        return false;
+    }
+
+    m_ReadOnly = readOnly;
+    m_Entries.clear();
+    m_Data.clear();
+    m_Size = sizeof(Signature);
+    const uint64_t FileSize = static_cast<uint64_t>(Functions::getFileSize(m_File));
+    for (;;) {
+        char Tag[16];
+        unsigned long long Offset = 0, Size = 0, Hash = 0;
+        unsigned int Length = 0;
+        if (fscanf(m_File, "%15s %llu %llu %llx %u", Tag, &Offset, &Size, &Hash, &Length) != 5 ||
+            strcmp(Tag, "file") != 0 || Length == 0 || Length > MaxNameLength || fgetc(m_File) != ' ')
+            break;
+        string Name(Length, '\0');
+        if (fread(&Name[0], Length, 1, m_File) != 1 || fgetc(m_File) != '\n')
+            break;
+        uint64_t End = 0;
+        if (!Functions::tellFile(m_File, &End))
+            break;
+        if (Offset == 0) {
+            Offset = End;
+            End += Size;
+            if (End > FileSize || !Functions::seekFile(m_File, End))
+                break;
+            m_Data.insert(make_pair(make_pair(static_cast<uint64_t>(Hash), static_cast<uint64_t>(Size)),
+                                    static_cast<uint64_t>(Offset)));
+        }
+        m_Entries.push_back(TEntry(Name, Offset, Size, Hash));
+        m_Size = End;
+    }
+
+    if (!readOnly &&
+        (!Functions::seekFile(m_File, m_Size) || !Functions::resizeFile(m_File, m_Size)))
+    {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    LOG_V("Backup archive has %u files.\n", static_cast<unsigned int>(m_Entries.size()));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::add(const string& fileName)
+{
+    vector<char> Data;
+    return Functions::readFile(fileName, &Data) && add(fileName, Data);
+}
+
+//------------------------------------------------------------------------------
+// Storing of file content, which was read before.
+
+bool TBackupArchive::add(const string& fileName, const vector<char>& data)
+{
+    const uint64_t Hash = Functions::hash(data.data(), data.size());
+    uint64_t Offset = 0;
+    const bool Found = findData(Hash, data, &Offset);
+    if (Found) {
+        LOG_V("Storing file \"%s\" in archive (the same content is stored).\n", fileName.c_str());
+    }
+    else {
+        LOG_V("Storing file \"%s\" in archive.\n", fileName.c_str());
+    }
+
+    // Zero offset in record means that data follows the record.
+    TEntry Entry(fileName, Offset, data.size(), Hash);
+    if (!writeEntry("file", Entry))
+        return false;
+    if (!Found) {
+        Entry.Offset = m_Size;
+        if (!write(data.data(), data.size()))
+            return false;
+    }
+    // Data must be on disk before the file is patched and recorded in
+    // checkpoint.
+    if (!Functions::syncFile(m_File)) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    m_Entries.push_back(Entry);
+    if (!Found)
+        m_Data.insert(make_pair(make_pair(Hash, Entry.Size), Entry.Offset));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Restoring file content from archive. Data is copied by blocks.
+
+bool TBackupArchive::restoreFile(const TEntry& entry)
+{
+    LOG_V("Restoring file \"%s\" from archive.\n", entry.FileName.c_str());
+
+    FILE* File = fopen(entry.FileName.c_str(), "wb");
+    if (File == NULL) {
+        LOG_E("Error opening file \"%s\" for writing. Error %i.\n", entry.FileName.c_str(), errno);
+        return false;
+    }
+
+    bool Result = Functions::seekFile(m_File, entry.Offset);
+    char Buffer[CopyBufferSize];
+    for (uint64_t Pos = 0; Result && Pos < entry.Size; Pos += sizeof(Buffer)) {
+        const size_t Size = entry.Size - Pos < sizeof(Buffer) ? static_cast<size_t>(entry.Size - Pos) : sizeof(Buffer);
+        Result = fread(Buffer, Size, 1, m_File) == 1 && fwrite(Buffer, Size, 1, File) == 1;
+    }
+    if (fclose(File) != 0)
+        Result = false;
+
+    if (!Result)
+        LOG_E("Error restoring file \"%s\" from archive \"%s\".\n", entry.FileName.c_str(), m_FileName.c_str());
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::restore()
+{
+    if (m_File == NULL)
+        return false;
+
+    LOG_V("\nRestoring backup from archive \"%s\".\n", m_FileName.c_str());
+    if (!m_ReadOnly)
+        fflush(m_File);
+    bool Result = true;
+    for (TEntries::const_iterator Iter = m_Entries.begin(); Iter != m_Entries.end(); ++Iter)
+        if (!restoreFile(*Iter))
+            Result = false;
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Restoring of some files only. Files stay in archive.
+
+bool TBackupArchive::restoreFiles(const TStringSet& fileNames)
+{
+    if (m_File == NULL)
+        return false;
+
+    bool Result = true;
+    for (TEntries::const_iterator Iter = m_Entries.begin(); Iter != m_Entries.end(); ++Iter)
+        if (fileNames.count(Iter->FileName) != 0 && !restoreFile(*Iter))
+            Result = false;
+    Functions::seekFile(m_File, m_Size);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Writing index of all files and closing archive. The last line is
+// "end <offset of index>". Read-only archive is just closed.
+
+bool TBackupArchive::close()
+{
+    if (m_File == NULL)
+        return true;
+    if (m_ReadOnly) {
+        fclose(m_File);
+        m_File = NULL;
+        return true;
+    }
+
+    Functions::seekFile(m_File, m_Size);
+    const uint64_t IndexOffset = m_Size;
+    char Buffer[64];
+    int Length = sprintf(Buffer, "index %u\n", static_cast<unsigned int>(m_Entries.size()));
+    bool Result = write(Buffer, Length);
+    for (TEntries::const_iterator Iter = m_Entries.begin(); Result && Iter != m_Entries.end(); ++Iter)
+        Result = writeEntry("entry", *Iter);
+    if (Result) {
+        Length = sprintf(Buffer, "end %llu\n", static_cast<unsigned long long>(IndexOffset));
+        Result = write(Buffer, Length);
+    }
+    if (fclose(m_File) != 0)
+        Result = false;
+    m_File = NULL;
+
+    if (!Result)
+        LOG_E("Error writing to file \"%s\".\n", m_FileName.c_str());
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupArchive::remove()
+{
+    if (m_File != NULL) {
+        fclose(m_File);
+        m_File = NULL;
+    }
+    m_Entries.clear();
+    m_Data.clear();
+    return Functions::removeFile(m_FileName);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_BACKUPARCHIVE__
+#define __QTBINPATCHER2_BACKUPARCHIVE__
+
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "CommonTypes.hpp"
+
+//------------------------------------------------------------------------------
+// Archive of original files. Contents of files are appended to one archive
+// file; identical contents are stored once. Every file has record with its
+// name, size, hash and offset of its data (stored earlier or following the
+// record), so archive can be read even if it was not closed. Closed archive
+// ends with index of all files. Archive of interrupted run may be opened to
+// restore files or to add files. Archive kept after run may be opened
+// read-only to restore files.
+
+class TBackupArchive
+{
+    private :
+        struct TEntry {
+            std::string FileName;
+            uint64_t    Offset;
+            uint64_t    Size;
+            uint64_t    Hash;
+
+            TEntry(const std::string& fileName, uint64_t offset, uint64_t size, uint64_t hash);
+        };
+        typedef std::vector<TEntry> TEntries;
+        // Offsets of stored data by hash and size of data.
+        typedef std::multimap<std::pair<uint64_t, uint64_t>, uint64_t> TDataMap;
+
+        std::string m_FileName;
+        FILE*       m_File;
+        bool        m_ReadOnly;
+        TEntries    m_Entries;
+        TDataMap    m_Data;
+        uint64_t    m_Size;
+
+        TBackupArchive(const TBackupArchive&);
+        TBackupArchive& operator=(const TBackupArchive&);
+
+        bool write(const void* data, size_t size);
+        bool writeEntry(const char* tag, const TEntry& entry);
+        bool isSameData(uint64_t offset, const std::vector<char>& data);
+        bool findData(uint64_t hash, const std::vector<char>& data, uint64_t* pOffset);
+        bool restoreFile(const TEntry& entry);
+
+    public :
+        explicit TBackupArchive(const std::string& fileName);
+        ~TBackupArchive();
+
+        bool create();
+        bool open(bool readOnly = false);
+        bool add(const std::string& fileName);
+        bool add(const std::string& fileName, const std::vector<char>& data);
+        bool restore();
+        bool restoreFiles(const TStringSet& fileNames);
+        bool close();
+        bool remove();
+
+        inline const std::string& fileName() const
+            { return m_FileName; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_BACKUPARCHIVE__
@@ -0,0 +1,281 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "BackupJournal.hpp"
+
+#include <string.h>
+#include <errno.h>
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char         JournalSignature[] = "QtBinPatcher backup journal 1\n";
+static const unsigned int MaxNameLength      = 65536;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TBackupJournal::TRecord::TRecord(const string& fileName, uint64_t fileSize, uint64_t offset, uint64_t size, uint64_t dataOffset)
+    : FileName(fileName), FileSize(fileSize), Offset(offset), Size(size), DataOffset(dataOffset)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TBackupJournal::TBackupJournal(const string& fileName)
+    : m_FileName(fileName),
+      m_File(NULL),
+      m_Size(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TBackupJournal::~TBackupJournal()
+{
+    if (m_File != NULL)
+        fclose(m_File);
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::write(const void* data, size_t size)
+{
+    if (size > 0 && fwrite(data, size, 1, m_File) != 1) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    m_Size += size;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::create()
+{
+    LOG_V("Creating backup journal \"%s\".\n", m_FileName.c_str());
+
+    m_File = fopen(m_FileName.c_str(), "w+b");
+    if (m_File == NULL) {
+        LOG_E("Error opening file \"%s\" for writing. Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    m_Records.clear();
+    m_Size = 0;
+    return write(JournalSignature, sizeof(JournalSignature) - 1) && Functions::syncFile(m_File);
+}
+
+//------------------------------------------------------------------------------
+// Opening journal left by interrupted run. Records are read, incomplete last
+// record is cut off and new records are appended.
+
+bool TBackupJournal::open()
+{
+    LOG_V("Opening backup journal \"%s\".\n", m_FileName.c_str());
+
+    m_File = fopen(m_FileName.c_str(), "r+b");
+    if (m_File == NULL) {
+        LOG_E("Error opening file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+
+    char Signature[sizeof(JournalSignature) - 1];
+    if (fread(Signature, sizeof(Signature), 1, m_File) != 1 ||
+        memcmp(Signature, JournalSignature, sizeof(Signature)) != 0)
+    {
+        LOG_E("File \"%s\" is not a backup journal.\n", m_FileName.c_str());
+        fclose(m_File);
+        m_File = NULL;
+        return false;
+    }
+
+    m_Records.clear();
+    m_Size = sizeof(Signature);
+    const uint64_t FileSize = static_cast<uint64_t>(Functions::getFileSize(m_File));
+    for (;;) {
+        unsigned long long Size = 0, Offset = 0, RangeSize = 0;
+        unsigned int Length = 0;
+        if (fscanf(m_File, "range %llu %llu %llu %u", &Size, &Offset, &RangeSize, &Length) != 4 ||
+            Length == 0 || Length > MaxNameLength || fgetc(m_File) != ' ')
+            break;
+        string Name(Length, '\0');
+        if (fread(&Name[0], Length, 1, m_File) != 1 || fgetc(m_File) != '\n')
+            break;
+        uint64_t DataOffset = 0;
+        if (!Functions::tellFile(m_File, &DataOffset) ||
+            DataOffset + RangeSize > FileSize || !Functions::seekFile(m_File, DataOffset + RangeSize))
+            break;
+        m_Records.push_back(TRecord(Name, Size, Offset, RangeSize, DataOffset));
+        m_Size = DataOffset + RangeSize;
+    }
+
+    if (!Functions::seekFile(m_File, m_Size) || !Functions::resizeFile(m_File, m_Size))
+    {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    LOG_V("Backup journal has %u records.\n", static_cast<unsigned int>(m_Records.size()));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Journaling of ranges of file, which will be changed. Data is the original
+// content of the whole file. Record of range is
+// "range <file size> <offset> <size> <name length> <name>" followed by the
+// original bytes. Records are synced to disk before the file is opened for
+// writing, so they survive power loss as well as killed process.
+
+bool TBackupJournal::add(const string& fileName, const char* data, size_t fileSize, const TFileRanges& ranges)
+{
+    TMutexLocker Locker(m_Mutex);
+    if (m_File == NULL)
+        return false;
+
+    LOG_V("  Journaling %u changed parts of file.\n", static_cast<unsigned int>(ranges.size()));
+    bool Result = Functions::seekFile(m_File, m_Size);
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Result && Iter != ranges.end(); ++Iter) {
+        char Buffer[128];
+        const int Length = sprintf(Buffer, "range %llu %llu %llu %u ",
+                                   static_cast<unsigned long long>(fileSize),
+                                   static_cast<unsigned long long>(Iter->Offset),
+                                   static_cast<unsigned long long>(Iter->Size),
+                                   static_cast<unsigned int>(fileName.length()));
+        Result = write(Buffer, Length) &&
+                 write(fileName.data(), fileName.length()) &&
+                 write("\n", 1);
+        if (Result) {
+            m_Records.push_back(TRecord(fileName, fileSize, Iter->Offset, Iter->Size, m_Size));
+            Result = write(data + Iter->Offset, Iter->Size);
+        }
+    }
+    if (Result && !Functions::syncFile(m_File)) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        Result = false;
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::restoreRecord(const TRecord& record)
+{
+    FILE* File = fopen(record.FileName.c_str(), "r+b");
+    if (File == NULL) {
+        LOG_E("Error opening file \"%s\". Error %i.\n", record.FileName.c_str(), errno);
+        return false;
+    }
+
+    vector<char> Data(static_cast<size_t>(record.Size));
+    bool Result = Functions::seekFile(m_File, record.DataOffset) &&
+                  (Data.empty() || fread(Data.data(), Data.size(), 1, m_File) == 1);
+    if (Result)
+        Result = Functions::seekFile(File, record.Offset) &&
+                 (Data.empty() || fwrite(Data.data(), Data.size(), 1, File) == 1) &&
+                 Functions::resizeFile(File, record.FileSize);
+    if (fclose(File) != 0)
+        Result = false;
+
+    if (!Result)
+        LOG_E("Error restoring file \"%s\" from journal \"%s\".\n", record.FileName.c_str(), m_FileName.c_str());
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::restore()
+{
+    TMutexLocker Locker(m_Mutex);
+    if (m_File == NULL)
+        return false;
+
+    LOG_V("\nRestoring backup from journal \"%s\".\n", m_FileName.c_str());
+    bool Result = true;
+    for (TRecords::const_reverse_iterator Iter = m_Records.rbegin(); Iter != m_Records.rend(); ++Iter) {
+        if (Iter == m_Records.rbegin() || (Iter - 1)->FileName != Iter->FileName) {
+            LOG_V("Restoring file \"%s\".\n", Iter->FileName.c_str());
+        }
+        if (!restoreRecord(*Iter))
+            Result = false;
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Restoring of some files only. Records stay in journal.
+
+bool TBackupJournal::restoreFiles(const TStringSet& fileNames)
+{
+    TMutexLocker Locker(m_Mutex);
+    if (m_File == NULL)
+        return false;
+
+    bool Result = true;
+    for (TRecords::const_reverse_iterator Iter = m_Records.rbegin(); Iter != m_Records.rend(); ++Iter)
+        if (fileNames.count(Iter->FileName) != 0) {
+            LOG_V("Restoring file \"%s\" from journal.\n", Iter->FileName.c_str());
+            if (!restoreRecord(*Iter))
+                Result = false;
+        }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::close()
+{
+    TMutexLocker Locker(m_Mutex);
+    if (m_File == NULL)
+        return true;
+
+    const bool Result = fclose(m_File) == 0;
+    m_File = NULL;
+    if (!Result)
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TBackupJournal::remove()
+{
+    close();
+    m_Records.clear();
+    return Functions::removeFile(m_FileName);
+}
+
+//------------------------------------------------------------------------------
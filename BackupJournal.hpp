@@ -0,0 +1,93 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_BACKUPJOURNAL__
+#define __QTBINPATCHER2_BACKUPJOURNAL__
+
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "CommonTypes.hpp"
+#include "Threads.hpp"
+
+//------------------------------------------------------------------------------
+// Write-ahead journal of changes of files. Before parts of file are written,
+// their original bytes and original size of file are appended to journal.
+// Restoring replays records in reverse order: original bytes are written
+// back and file is truncated to its original size. Journal of interrupted
+// run may be opened to restore files or to append records. Journal may be
+// used from several threads.
+
+class TBackupJournal
+{
+    private :
+        struct TRecord {
+            std::string FileName;
+            uint64_t    FileSize;
+            uint64_t    Offset;
+            uint64_t    Size;
+            uint64_t    DataOffset;
+
+            TRecord(const std::string& fileName, uint64_t fileSize, uint64_t offset, uint64_t size, uint64_t dataOffset);
+        };
+        typedef std::vector<TRecord> TRecords;
+
+        std::string m_FileName;
+        FILE*       m_File;
+        TRecords    m_Records;
+        uint64_t    m_Size;
+        TMutex      m_Mutex;
+
+        TBackupJournal(const TBackupJournal&);
+        TBackupJournal& operator=(const TBackupJournal&);
+
+        bool write(const void* data, size_t size);
+        bool restoreRecord(const TRecord& record);
+
+    public :
+        explicit TBackupJournal(const std::string& fileName);
+        ~TBackupJournal();
+
+        bool create();
+        bool open();
+        bool add(const std::string& fileName, const char* data, size_t fileSize, const TFileRanges& ranges);
+        bool restore();
+        bool restoreFiles(const TStringSet& fileNames);
+        bool close();
+        bool remove();
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_BACKUPJOURNAL__
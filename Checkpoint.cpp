@@ -0,0 +1,446 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "Checkpoint.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char         CheckpointSignature[] = "QtBinPatcher checkpoint 1\n";
+static const unsigned int MaxValueLength        = 65536;
+
+//------------------------------------------------------------------------------
+
+TCheckpoint::TCheckpoint(const string& fileName)
+    : m_FileName(fileName),
+      m_File(NULL),
+      m_NoBackup(false),
+      m_Started(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TCheckpoint::~TCheckpoint()
+{
+    if (m_File != NULL) {
+        fclose(m_File);
+        Functions::removeFile(m_FileName);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+// Ranges of file in record of done file are "<offset>:<size>" separated by
+// spaces.
+
+static string rangesToStr(const TFileRanges& ranges)
+{
+    string Result;
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Iter != ranges.end(); ++Iter) {
+        char Buffer[48];
+        sprintf(Buffer, "%s%llu:%llu", Result.empty() ? "" : " ",
+                static_cast<unsigned long long>(Iter->Offset),
+                static_cast<unsigned long long>(Iter->Size));
+        Result += Buffer;
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+static bool parseRanges(const string& str, TFileRanges* pRanges)
+{
+    pRanges->clear();
+    const char* p = str.c_str();
+    while (*p != '\0') {
+        char* End = NULL;
+        const unsigned long long Offset = strtoull(p, &End, 10);
+        if (End == p || *End != ':')
+            return false;
+        p = End + 1;
+        const unsigned long long Size = strtoull(p, &End, 10);
+        if (End == p || (*End != ' ' && *End != '\0'))
+            return false;
+        pRanges->push_back(TFileRange(static_cast<size_t>(Offset), static_cast<size_t>(Size)));
+        p = *End == ' ' ? End + 1 : End;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Hash of ranges of file is Functions::hash() of their content chained in
+// order of ranges.
+
+bool TCheckpoint::getRangesHash(const string& fileName, const TFileRanges& ranges, uint64_t* pHash)
+{
+    FILE* File = fopen(fileName.c_str(), "rb");
+    if (File == NULL)
+        return false;
+
+    bool Result = true;
+    vector<char> Buf;
+    *pHash = Functions::hash(NULL, 0);
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Result && Iter != ranges.end(); ++Iter) {
+        Buf.resize(Iter->Size);
+        Result = Functions::seekFile(File, Iter->Offset) &&
+                 (Buf.empty() || fread(Buf.data(), Buf.size(), 1, File) == 1);
+        if (Result)
+            *pHash = Functions::hash(Buf.data(), Buf.size(), *pHash);
+    }
+    fclose(File);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Record is "<tag>" followed by " <length> <value>" for each value and end
+// of line. Records are written under lock of mutex and flushed, so they are
+// kept if process is killed; they reach the disk at the next sync (flush()).
+
+bool TCheckpoint::writeRecord(const char* tag, const string* values, size_t count)
+{
+    if (m_File == NULL)
+        return false;
+
+    bool Result = fputs(tag, m_File) >= 0;
+    for (size_t i = 0; Result && i < count; ++i)
+        Result = fprintf(m_File, " %u ", static_cast<unsigned int>(values[i].length())) > 0 &&
+                 (values[i].empty() || fwrite(values[i].data(), values[i].length(), 1, m_File) == 1);
+    if (Result)
+        Result = fputc('\n', m_File) != EOF && fflush(m_File) == 0;
+    if (!Result)
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::writeRecord(const char* tag, const string& value)
+{
+    return writeRecord(tag, &value, 1);
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::writeRecord(const char* tag, const string& value1, const string& value2)
+{
+    const string Values[] = { value1, value2 };
+    return writeRecord(tag, Values, 2);
+}
+
+//------------------------------------------------------------------------------
+// Records must reach the disk before the next step starts: backup and start
+// records precede changes of files, which can't be undone without them.
+
+bool TCheckpoint::flush()
+{
+    if (m_File == NULL || !Functions::syncFile(m_File)) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Reading of record. Returns false at the end of file or at incomplete
+// record (process was killed while writing it).
+
+bool TCheckpoint::readRecord(string* pTag, TStringList* pValues)
+{
+    pTag->clear();
+    pValues->clear();
+
+    int c;
+    while ((c = fgetc(m_File)) != EOF && c != ' ' && c != '\n')
+        pTag->push_back(static_cast<char>(c));
+    while (c == ' ') {
+        unsigned int Length = 0;
+        if (fscanf(m_File, "%u", &Length) != 1 || Length > MaxValueLength || fgetc(m_File) != ' ')
+            return false;
+        string Value(Length, '\0');
+        if (Length > 0 && fread(&Value[0], Length, 1, m_File) != 1)
+            return false;
+        pValues->push_back(Value);
+        c = fgetc(m_File);
+    }
+    return c == '\n' && !pTag->empty();
+}
+
+//------------------------------------------------------------------------------
+
+void TCheckpoint::applyRecord(const string& tag, const TStringList& values)
+{
+    const vector<string> Values(values.begin(), values.end());
+    if (tag == "newdir" && Values.size() == 1)
+        m_NewQtDir = Values[0];
+    else if (tag == "nobackup" && Values.empty())
+        m_NoBackup = true;
+    else if (tag == "archive" && Values.size() == 1)
+        m_ArchiveName = Values[0];
+    else if (tag == "journal" && Values.size() == 1)
+        m_JournalName = Values[0];
+    else if (tag == "txtvalue" && Values.size() == 2)
+        m_TxtPatchValues[Values[0]] = Values[1];
+    else if (tag == "binvalue" && Values.size() == 2)
+        m_BinPatchValues[Values[0]] = Values[1];
+    else if (tag == "txtfile" && Values.size() == 1)
+        m_TxtFiles.push_back(Values[0]);
+    else if (tag == "binfile" && Values.size() == 1)
+        m_BinFiles.push_back(Values[0]);
+    else if (tag == "start" && Values.empty())
+        m_Started = true;
+    else if (tag == "backup" && Values.size() == 2)
+        m_Backups[Values[0]] = Values[1];
+    else if (tag == "memory" && Values.size() == 1)
+        m_MemoryBackups.push_back(Values[0]);
+    else if (tag == "done" && Values.size() == 4) {
+        TDone Done;
+        Done.FileSize = strtoull(Values[1].c_str(), NULL, 10);
+        Done.Hash = strtoull(Values[2].c_str(), NULL, 16);
+        if (parseRanges(Values[3], &Done.Ranges))
+            m_Done[Values[0]] = Done;
+    }
+    else
+        LOG_V("Unknown record \"%s\" in checkpoint. Skipping.\n", tag.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::create(const string& newQtDir, bool noBackup)
+{
+    LOG_V("Creating checkpoint \"%s\".\n", m_FileName.c_str());
+
+    close();
+    m_File = fopen(m_FileName.c_str(), "wb");
+    if (m_File == NULL) {
+        LOG_E("Error opening file \"%s\" for writing. Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+
+    TMutexLocker Locker(m_Mutex);
+    m_NewQtDir = newQtDir;
+    m_NoBackup = noBackup;
+    m_Started = false;
+    m_ArchiveName.clear();
+    m_JournalName.clear();
+    m_TxtPatchValues.clear();
+    m_BinPatchValues.clear();
+    m_TxtFiles.clear();
+    m_BinFiles.clear();
+    m_Backups.clear();
+    m_MemoryBackups.clear();
+    m_Done.clear();
+    bool Result = fputs(CheckpointSignature, m_File) >= 0 &&
+                  writeRecord("newdir", newQtDir);
+    if (Result && noBackup)
+        Result = writeRecord("nobackup", NULL, 0);
+    return Result && flush();
+}
+
+//------------------------------------------------------------------------------
+// Reading of checkpoint left by interrupted run. Incomplete last record is
+// cut off and new records are appended to checkpoint.
+
+bool TCheckpoint::load()
+{
+    LOG_V("Loading checkpoint \"%s\".\n", m_FileName.c_str());
+
+    FILE* File = fopen(m_FileName.c_str(), "r+b");
+    if (File == NULL) {
+        LOG_E("Checkpoint \"%s\" not found. Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+
+    char Signature[sizeof(CheckpointSignature) - 1];
+    if (fread(Signature, sizeof(Signature), 1, File) != 1 ||
+        memcmp(Signature, CheckpointSignature, sizeof(Signature)) != 0)
+    {
+        LOG_E("File \"%s\" is not a checkpoint.\n", m_FileName.c_str());
+        fclose(File);
+        return false;
+    }
+
+    TMutexLocker Locker(m_Mutex);
+    m_File = File;
+    long Size = ftell(m_File);
+    string Tag;
+    TStringList Values;
+    while (readRecord(&Tag, &Values)) {
+        applyRecord(Tag, Values);
+        Size = ftell(m_File);
+    }
+
+    if (fseek(m_File, Size, SEEK_SET) != 0 || !Functions::resizeFile(m_File, Size)) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", m_FileName.c_str(), errno);
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::addArchive(const string& fileName)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_ArchiveName = fileName;
+    return writeRecord("archive", fileName) && flush();
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::addJournal(const string& fileName)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_JournalName = fileName;
+    return writeRecord("journal", fileName) && flush();
+}
+
+//------------------------------------------------------------------------------
+
+bool TCheckpoint::addPatchValues(const TStringMap& txtValues, const TStringMap& binValues)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_TxtPatchValues = txtValues;
+    m_BinPatchValues = binValues;
+    bool Result = true;
+    for (TStringMap::const_iterator Iter = txtValues.begin(); Result && Iter != txtValues.end(); ++Iter)
+        Result = writeRecord("txtvalue", Iter->first, Iter->second);
+    for (TStringMap::const_iterator Iter = binValues.begin(); Result && Iter != binValues.end(); ++Iter)
+        Result = writeRecord("binvalue", Iter->first, Iter->second);
+    return Result && flush();
+}
+
+//------------------------------------------------------------------------------
+// Lists of files are followed by "start" record: since it all files are
+// known and may be changed.
+
+bool TCheckpoint::addFiles(const TStringList& txtFiles, const TStringList& binFiles)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_TxtFiles = txtFiles;
+    m_BinFiles = binFiles;
+    m_Started = true;
+    bool Result = true;
+    for (TStringList::const_iterator Iter = txtFiles.begin(); Result && Iter != txtFiles.end(); ++Iter)
+        Result = writeRecord("txtfile", *Iter);
+    for (TStringList::const_iterator Iter = binFiles.begin(); Result && Iter != binFiles.end(); ++Iter)
+        Result = writeRecord("binfile", *Iter);
+    return Result && writeRecord("start", NULL, 0) && flush();
+}
+
+//------------------------------------------------------------------------------
+// Empty name of backup file means that file is stored in archive.
+
+bool TCheckpoint::addBackup(const string& fileName, const string& bakFileName)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_Backups[fileName] = bakFileName;
+    return writeRecord("backup", fileName, bakFileName);
+}
+
+//------------------------------------------------------------------------------
+// Copy of file is kept in memory only, so it is lost if process is killed.
+
+bool TCheckpoint::addMemoryBackup(const string& fileName)
+{
+    TMutexLocker Locker(m_Mutex);
+    m_MemoryBackups.push_back(fileName);
+    return writeRecord("memory", fileName);
+}
+
+//------------------------------------------------------------------------------
+// Done file is recorded with ranges written by patcher and hash of their new
+// content (see getRangesHash()), which patcher takes from its buffers. So
+// the file isn't read back after patching.
+
+bool TCheckpoint::addDone(const string& fileName, uint64_t fileSize, const TFileRanges& ranges, uint64_t hash)
+{
+    char Size[32], Hash[32];
+    sprintf(Size, "%llu", static_cast<unsigned long long>(fileSize));
+    sprintf(Hash, "%016llx", static_cast<unsigned long long>(hash));
+    const string Values[] = { fileName, Size, Hash, rangesToStr(ranges) };
+
+    TMutexLocker Locker(m_Mutex);
+    TDone& Done = m_Done[fileName];
+    Done.FileSize = fileSize;
+    Done.Ranges = ranges;
+    Done.Hash = hash;
+    return writeRecord("done", Values, 4);
+}
+
+//------------------------------------------------------------------------------
+// File is done if it was done and wasn't changed since: it has the same size
+// and the same content of written ranges.
+
+bool TCheckpoint::isDone(const string& fileName) const
+{
+    TDoneMap::const_iterator Iter = m_Done.find(fileName);
+    if (Iter == m_Done.end())
+        return false;
+
+    const TDone& Done = Iter->second;
+    uint64_t Size = 0, Time = 0, Hash = 0;
+    return Functions::getFileInfo(fileName, &Size, &Time) && Size == Done.FileSize &&
+           getRangesHash(fileName, Done.Ranges, &Hash) && Hash == Done.Hash;
+}
+
+//------------------------------------------------------------------------------
+// Syncing of records of single files (backups and done files) at the end of
+// step.
+
+bool TCheckpoint::sync()
+{
+    TMutexLocker Locker(m_Mutex);
+    return flush();
+}
+
+//------------------------------------------------------------------------------
+
+void TCheckpoint::close()
+{
+    if (m_File != NULL) {
+        fclose(m_File);
+        m_File = NULL;
+    }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,125 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_CHECKPOINT__
+#define __QTBINPATCHER2_CHECKPOINT__
+
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+
+#include "CommonTypes.hpp"
+#include "Threads.hpp"
+
+//------------------------------------------------------------------------------
+// Progress of patching. Patch values, lists of files, backups and files,
+// which are done (with hashes of their written parts), are appended to file.
+// Records of each step are synced once before the next step starts, records
+// of single files are only flushed. If process was killed, the run can be
+// resumed or rolled back from it. File is removed, when checkpoint is
+// destroyed (run was finished or rolled back), unless it was closed before.
+// Files may be done from several threads.
+
+class TCheckpoint
+{
+    public :
+        struct TDone
+        {
+            uint64_t    FileSize;
+            TFileRanges Ranges;
+            uint64_t    Hash;
+        };
+        typedef std::map<std::string, TDone> TDoneMap;
+
+    private :
+        std::string m_FileName;
+        FILE*       m_File;
+        TMutex      m_Mutex;
+        std::string m_NewQtDir;
+        bool        m_NoBackup;
+        bool        m_Started;
+        std::string m_ArchiveName;
+        std::string m_JournalName;
+        TStringMap  m_TxtPatchValues;
+        TStringMap  m_BinPatchValues;
+        TStringList m_TxtFiles;
+        TStringList m_BinFiles;
+        TStringMap  m_Backups;
+        TStringList m_MemoryBackups;
+        TDoneMap    m_Done;
+
+        TCheckpoint(const TCheckpoint&);
+        TCheckpoint& operator=(const TCheckpoint&);
+
+        static bool getRangesHash(const std::string& fileName, const TFileRanges& ranges, uint64_t* pHash);
+        bool writeRecord(const char* tag, const std::string* values, size_t count);
+        bool writeRecord(const char* tag, const std::string& value);
+        bool writeRecord(const char* tag, const std::string& value1, const std::string& value2);
+        bool flush();
+        bool readRecord(std::string* pTag, TStringList* pValues);
+        void applyRecord(const std::string& tag, const TStringList& values);
+
+    public :
+        explicit TCheckpoint(const std::string& fileName);
+        ~TCheckpoint();
+
+        bool create(const std::string& newQtDir, bool noBackup);
+        bool load();
+        bool addArchive(const std::string& fileName);
+        bool addJournal(const std::string& fileName);
+        bool addPatchValues(const TStringMap& txtValues, const TStringMap& binValues);
+        bool addFiles(const TStringList& txtFiles, const TStringList& binFiles);
+        bool addBackup(const std::string& fileName, const std::string& bakFileName);
+        bool addMemoryBackup(const std::string& fileName);
+        bool addDone(const std::string& fileName, uint64_t fileSize, const TFileRanges& ranges, uint64_t hash);
+        bool isDone(const std::string& fileName) const;
+        bool sync();
+        void close();
+
+        inline const std::string& fileName() const { return m_FileName; }
+        inline const std::string& newQtDir() const { return m_NewQtDir; }
+        inline bool noBackup() const { return m_NoBackup; }
+        inline bool isStarted() const { return m_Started; }
+        inline const std::string& archiveName() const { return m_ArchiveName; }
+        inline const std::string& journalName() const { return m_JournalName; }
+        inline const TStringMap& txtPatchValues() const { return m_TxtPatchValues; }
+        inline const TStringMap& binPatchValues() const { return m_BinPatchValues; }
+        inline const TStringList& txtFiles() const { return m_TxtFiles; }
+        inline const TStringList& binFiles() const { return m_BinFiles; }
+        inline const TStringMap& backups() const { return m_Backups; }
+        inline const TStringList& memoryBackups() const { return m_MemoryBackups; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_CHECKPOINT__
@@ -94,16 +94,48 @@ string TCmdLineChecker::check(const TStringListMap& argsMap)
     TCmdLineChecker Checker(argsMap);
 
     Checker.checkIncompatible(OPT_BACKUP, OPT_NOBACKUP);
-    Checker.check(OPT_VERSION,  otNoValue);
-    Checker.check(OPT_HELP,     otNoValue);
-    Checker.check(OPT_VERBOSE,  otNoValue);
-    Checker.check(OPT_LOGFILE,  otSingleValue);
-    Checker.check(OPT_BACKUP,   otNoValue);
-    Checker.check(OPT_NOBACKUP, otNoValue);
-    Checker.check(OPT_FORCE,    otNoValue);
-    Checker.check(OPT_QT_DIR,   otSingleValue);
-    Checker.check(OPT_NEW_DIR,  otSingleValue);
-    Checker.check(OPT_OLD_DIR,  otMultiValue);
+    Checker.checkIncompatible(OPT_BACKUP_ARCHIVE, OPT_NOBACKUP);
+    Checker.checkIncompatible(OPT_BACKUP_JOURNAL, OPT_NOBACKUP);
+    Checker.checkIncompatible(OPT_BACKUP_JOURNAL, OPT_BACKUP_ARCHIVE);
+    Checker.checkIncompatible(OPT_BACKUP_MEMORY, OPT_NOBACKUP);
+    Checker.checkIncompatible(OPT_BACKUP_MEMORY, OPT_BACKUP_JOURNAL);
+    Checker.checkIncompatible(OPT_RESUME, OPT_ROLLBACK);
+    Checker.checkIncompatible(OPT_ROLLBACK, OPT_BACKUP);
+    Checker.checkIncompatible(OPT_ROLLBACK, OPT_NOBACKUP);
+    Checker.checkIncompatible(OPT_ROLLBACK, OPT_BACKUP_ARCHIVE);
+    Checker.checkIncompatible(OPT_ROLLBACK, OPT_BACKUP_JOURNAL);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_RESUME);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_ROLLBACK);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_ATOMIC);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_BACKUP_ARCHIVE);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_BACKUP_JOURNAL);
+    Checker.checkIncompatible(OPT_SHADOW_TREE, OPT_BACKUP_MEMORY);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_BACKUP);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_NOBACKUP);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_BACKUP_ARCHIVE);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_BACKUP_JOURNAL);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_RESUME);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_ROLLBACK);
+    Checker.checkIncompatible(OPT_RESTORE_ARCHIVE, OPT_SHADOW_TREE);
+    Checker.check(OPT_VERSION,        otNoValue);
+    Checker.check(OPT_HELP,           otNoValue);
+    Checker.check(OPT_VERBOSE,        otNoValue);
+    Checker.check(OPT_LOGFILE,        otSingleValue);
+    Checker.check(OPT_BACKUP,         otNoValue);
+    Checker.check(OPT_NOBACKUP,       otNoValue);
+    Checker.check(OPT_BACKUP_ARCHIVE, otSingleValue);
+    Checker.check(OPT_BACKUP_JOURNAL, otSingleValue);
+    Checker.check(OPT_BACKUP_MEMORY,  otSingleValue);
+    Checker.check(OPT_RESUME,         otNoValue);
+    Checker.check(OPT_ROLLBACK,       otNoValue);
+    Checker.check(OPT_RESTORE_ARCHIVE, otSingleValue);
+    Checker.check(OPT_SHADOW_TREE,    otNoValue);
+    Checker.check(OPT_FORCE,          otNoValue);
+    Checker.check(OPT_ATOMIC,         otNoValue);
+    Checker.check(OPT_JOBS,           otSingleValue);
+    Checker.check(OPT_QT_DIR,         otSingleValue);
+    Checker.check(OPT_NEW_DIR,        otSingleValue);
+    Checker.check(OPT_OLD_DIR,        otMultiValue);
     Checker.endCheck();
 
     return Checker.m_ErrorString;
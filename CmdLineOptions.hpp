@@ -34,16 +34,25 @@
 
 //------------------------------------------------------------------------------
 
-#define OPT_VERSION  "version"
-#define OPT_HELP     "help"
-#define OPT_VERBOSE  "verbose"
-#define OPT_LOGFILE  "logfile"
-#define OPT_BACKUP   "backup"
-#define OPT_NOBACKUP "nobackup"
-#define OPT_FORCE    "force"
-#define OPT_QT_DIR   "qt-dir"
-#define OPT_NEW_DIR  "new-dir"
-#define OPT_OLD_DIR  "old-dir"
+#define OPT_VERSION        "version"
+#define OPT_HELP           "help"
+#define OPT_VERBOSE        "verbose"
+#define OPT_LOGFILE        "logfile"
+#define OPT_BACKUP         "backup"
+#define OPT_NOBACKUP       "nobackup"
+#define OPT_BACKUP_ARCHIVE "backup-archive"
+#define OPT_BACKUP_JOURNAL "backup-journal"
+#define OPT_BACKUP_MEMORY  "backup-memory"
+#define OPT_RESUME         "resume"
+#define OPT_ROLLBACK       "rollback"
+#define OPT_RESTORE_ARCHIVE "restore-archive"
+#define OPT_SHADOW_TREE    "shadow-tree"
+#define OPT_FORCE          "force"
+#define OPT_ATOMIC         "atomic"
+#define OPT_JOBS           "jobs"
+#define OPT_QT_DIR         "qt-dir"
+#define OPT_NEW_DIR        "new-dir"
+#define OPT_OLD_DIR        "old-dir"
 
 //------------------------------------------------------------------------------
 
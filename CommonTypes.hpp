@@ -37,11 +37,30 @@
 #include <string>
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
 
 //------------------------------------------------------------------------------
 
 typedef std::list<std::string> TStringList;
 typedef std::map<std::string, std::string> TStringMap;
+typedef std::set<std::string> TStringSet;
+
+//------------------------------------------------------------------------------
+// Part of file (offset and size in bytes).
+
+struct TFileRange
+{
+    size_t Offset;
+    size_t Size;
+
+    inline TFileRange(size_t offset, size_t size)
+        : Offset(offset), Size(size) {}
+    inline bool operator<(const TFileRange& other) const
+        { return Offset < other.Offset; }
+};
+
+typedef std::vector<TFileRange> TFileRanges;
 
 //------------------------------------------------------------------------------
 
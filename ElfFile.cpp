@@ -0,0 +1,305 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "ElfFile.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const unsigned char ElfMagic[] = { 0x7F, 'E', 'L', 'F' };
+
+static const size_t   EI_CLASS      = 4;
+static const size_t   EI_DATA       = 5;
+static const unsigned ELFCLASS32    = 1;
+static const unsigned ELFCLASS64    = 2;
+static const unsigned ELFDATA2LSB   = 1;
+static const unsigned ELFDATA2MSB   = 2;
+static const uint16_t ET_REL        = 1;
+static const uint32_t SHT_SYMTAB    = 2;
+static const uint32_t SHT_NOBITS    = 8;
+static const uint32_t SHT_DYNSYM    = 11;
+static const uint16_t SHN_LORESERVE = 0xFF00;
+static const uint16_t SHN_XINDEX    = 0xFFFF;
+
+//------------------------------------------------------------------------------
+// Sections, which can contain "qt_????path=" slots.
+
+static const char* const DataSections[] = {
+    ".rodata",
+    ".data"
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TElfFile::TElfFile(const char* data, size_t size)
+    : m_pData(reinterpret_cast<const unsigned char*>(data)),
+      m_Size(size),
+      m_Is64(false),
+      m_IsBigEndian(false),
+      m_IsRelocatable(false)
+{
+    if (isElf(data, size)) {
+        m_Is64 = m_pData[EI_CLASS] == ELFCLASS64;
+        m_IsBigEndian = m_pData[EI_DATA] == ELFDATA2MSB;
+        m_IsRelocatable = read16(0x10) == ET_REL;
+        if (!readSections())
+            m_Sections.clear();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool TElfFile::isElf(const char* data, size_t size)
+{
+    const unsigned char* const Data = reinterpret_cast<const unsigned char*>(data);
+    return size >= 64 &&
+           memcmp(Data, ElfMagic, sizeof(ElfMagic)) == 0 &&
+           (Data[EI_CLASS] == ELFCLASS32 || Data[EI_CLASS] == ELFCLASS64) &&
+           (Data[EI_DATA] == ELFDATA2LSB || Data[EI_DATA] == ELFDATA2MSB);
+}
+
+//------------------------------------------------------------------------------
+
+bool TElfFile::inFile(uint64_t offset, uint64_t size) const
+{
+    return offset <= m_Size && size <= m_Size - offset;
+}
+
+//------------------------------------------------------------------------------
+
+uint16_t TElfFile::read16(uint64_t offset) const
+{
+    const unsigned char* p = m_pData + offset;
+    return m_IsBigEndian ? static_cast<uint16_t>((p[0] << 8) | p[1])
+                         : static_cast<uint16_t>((p[1] << 8) | p[0]);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t TElfFile::read32(uint64_t offset) const
+{
+    const uint32_t a = read16(offset);
+    const uint32_t b = read16(offset + 2);
+    return m_IsBigEndian ? (a << 16) | b : (b << 16) | a;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t TElfFile::read64(uint64_t offset) const
+{
+    const uint64_t a = read32(offset);
+    const uint64_t b = read32(offset + 4);
+    return m_IsBigEndian ? (a << 32) | b : (b << 32) | a;
+}
+
+//------------------------------------------------------------------------------
+// Reading of address or offset field (size depends on ELF class).
+
+uint64_t TElfFile::readWord(uint64_t offset) const
+{
+    return m_Is64 ? read64(offset) : read32(offset);
+}
+
+//------------------------------------------------------------------------------
+
+string TElfFile::readString(uint64_t offset, uint64_t end) const
+{
+    if (end > m_Size)
+        end = m_Size;
+    string Result;
+    for (uint64_t i = offset; i < end && m_pData[i] != '\0'; ++i)
+        Result += static_cast<char>(m_pData[i]);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TElfFile::readSections()
+{
+    const uint64_t ShOff     = m_Is64 ? read64(0x28) : read32(0x20);
+    const uint16_t ShEntSize = read16(m_Is64 ? 0x3A : 0x2E);
+    uint64_t       ShNum     = read16(m_Is64 ? 0x3C : 0x30);
+    uint32_t       ShStrNdx  = read16(m_Is64 ? 0x3E : 0x32);
+
+    if (ShOff == 0 || ShEntSize < (m_Is64 ? 64 : 40) || !inFile(ShOff, ShEntSize))
+        return false;
+
+    // Extended numbering: real values are in the first section header.
+    if (ShNum == 0)
+        ShNum = readWord(ShOff + (m_Is64 ? 32 : 20));
+    if (ShStrNdx == SHN_XINDEX)
+        ShStrNdx = read32(ShOff + (m_Is64 ? 40 : 24));
+
+    if (ShNum == 0 || ShNum > m_Size / ShEntSize || !inFile(ShOff, ShNum * ShEntSize))
+        return false;
+
+    m_Sections.resize(static_cast<size_t>(ShNum));
+    vector<uint32_t> NameOffsets(m_Sections.size());
+    for (size_t i = 0; i < m_Sections.size(); ++i) {
+        const uint64_t Header = ShOff + i * ShEntSize;
+        TSection& Section = m_Sections[i];
+        NameOffsets[i] = read32(Header);
+        Section.Type = read32(Header + 4);
+        if (m_Is64) {
+            Section.Addr    = read64(Header + 16);
+            Section.Offset  = read64(Header + 24);
+            Section.Size    = read64(Header + 32);
+            Section.Link    = read32(Header + 40);
+            Section.EntSize = read64(Header + 56);
+        }
+        else {
+            Section.Addr    = read32(Header + 12);
+            Section.Offset  = read32(Header + 16);
+            Section.Size    = read32(Header + 20);
+            Section.Link    = read32(Header + 24);
+            Section.EntSize = read32(Header + 36);
+        }
+    }
+
+    if (ShStrNdx >= m_Sections.size())
+        return false;
+    const TSection& StrTab = m_Sections[ShStrNdx];
+    if (!inFile(StrTab.Offset, StrTab.Size))
+        return false;
+    for (size_t i = 0; i < m_Sections.size(); ++i)
+        if (NameOffsets[i] < StrTab.Size)
+            m_Sections[i].Name = readString(StrTab.Offset + NameOffsets[i], StrTab.Offset + StrTab.Size);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Getting file ranges of data sections (".rodata", ".data" and their
+// subsections like ".data.rel.ro"). Returns false if there is no section
+// headers; the whole file must be scanned in this case.
+
+bool TElfFile::getDataRanges(TFileRanges* pRanges) const
+{
+    if (m_Sections.empty())
+        return false;
+
+    for (TSections::const_iterator Iter = m_Sections.begin(); Iter != m_Sections.end(); ++Iter)
+    {
+        if (Iter->Type == SHT_NOBITS || Iter->Size == 0 || !inFile(Iter->Offset, Iter->Size))
+            continue;
+        for (size_t i = 0; i < sizeof(DataSections)/sizeof(DataSections[0]); ++i) {
+            const size_t Length = strlen(DataSections[i]);
+            if (Iter->Name.compare(0, Length, DataSections[i]) == 0 &&
+                (Iter->Name.length() == Length || Iter->Name[Length] == '.'))
+            {
+                pRanges->push_back(TFileRange(static_cast<size_t>(Iter->Offset),
+                                              static_cast<size_t>(Iter->Size)));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Adding file ranges of defined symbols with names starting with prefix from
+// one symbol table.
+
+void TElfFile::addSymbolRanges(const TSection& symTab, const char* prefix, TFileRanges* pRanges) const
+{
+    const uint64_t SymSize = m_Is64 ? 24 : 16;
+    if (symTab.EntSize < SymSize || !inFile(symTab.Offset, symTab.Size) || symTab.Link >= m_Sections.size())
+        return;
+    const TSection& StrTab = m_Sections[symTab.Link];
+    if (!inFile(StrTab.Offset, StrTab.Size))
+        return;
+
+    const size_t PrefixLength = strlen(prefix);
+    const uint64_t Count = symTab.Size / symTab.EntSize;
+    for (uint64_t i = 0; i < Count; ++i)
+    {
+        const uint64_t Sym = symTab.Offset + i * symTab.EntSize;
+        const uint32_t NameOffset = read32(Sym);
+        if (NameOffset >= StrTab.Size || StrTab.Size - NameOffset < PrefixLength ||
+            memcmp(m_pData + StrTab.Offset + NameOffset, prefix, PrefixLength) != 0)
+            continue;
+
+        const uint64_t Value   = m_Is64 ? read64(Sym + 8)  : read32(Sym + 4);
+        const uint64_t Size    = m_Is64 ? read64(Sym + 16) : read32(Sym + 8);
+        const uint16_t Section = read16(m_Is64 ? Sym + 6 : Sym + 14);
+        if (Size == 0 || Section == 0 || Section >= SHN_LORESERVE || Section >= m_Sections.size())
+            continue;
+
+        // Symbol value is address (offset inside of section for object files).
+        const TSection& Data = m_Sections[Section];
+        if (Data.Type == SHT_NOBITS || (!m_IsRelocatable && Value < Data.Addr))
+            continue;
+        const uint64_t Delta = m_IsRelocatable ? Value : Value - Data.Addr;
+        if (Delta > Data.Size || Size > Data.Size - Delta || !inFile(Data.Offset + Delta, Size))
+            continue;
+
+        pRanges->push_back(TFileRange(static_cast<size_t>(Data.Offset + Delta), static_cast<size_t>(Size)));
+    }
+}
+
+//------------------------------------------------------------------------------
+// Getting file ranges of symbols with names starting with prefix from symbol
+// tables (".symtab" and ".dynsym"). Returns false if no symbols are found.
+
+bool TElfFile::getSymbolRanges(const char* prefix, TFileRanges* pRanges) const
+{
+    const size_t StartCount = pRanges->size();
+    for (TSections::const_iterator Iter = m_Sections.begin(); Iter != m_Sections.end(); ++Iter)
+        if (Iter->Type == SHT_SYMTAB || Iter->Type == SHT_DYNSYM)
+            addSymbolRanges(*Iter, prefix, pRanges);
+
+    // The same symbol can be found in both tables: merging overlapped ranges.
+    TFileRanges Ranges(pRanges->begin() + StartCount, pRanges->end());
+    sort(Ranges.begin(), Ranges.end());
+    pRanges->erase(pRanges->begin() + StartCount, pRanges->end());
+    for (TFileRanges::const_iterator Iter = Ranges.begin(); Iter != Ranges.end(); ++Iter) {
+        if (pRanges->size() > StartCount) {
+            TFileRange& Last = pRanges->back();
+            if (Iter->Offset <= Last.Offset + Last.Size) {
+                if (Iter->Offset + Iter->Size > Last.Offset + Last.Size)
+                    Last.Size = Iter->Offset + Iter->Size - Last.Offset;
+                continue;
+            }
+        }
+        pRanges->push_back(*Iter);
+    }
+
+    return pRanges->size() > StartCount;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,643 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "FileFinder.hpp"
+
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <deque>
+#include <set>
+#if defined(OS_WINDOWS)
+    #include <io.h>
+#elif defined(OS_LINUX)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+#include "Threads.hpp"
+#include "Inventory.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// File names on Windows are case-insensitive.
+
+static inline bool sameChar(char c1, char c2)
+{
+    #if defined(OS_WINDOWS)
+        return tolower(static_cast<unsigned char>(c1)) == tolower(static_cast<unsigned char>(c2));
+    #else
+        return c1 == c2;
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+static bool startsWith(const string& str, const string& start)
+{
+    if (str.length() < start.length())
+        return false;
+    for (size_t i = 0; i < start.length(); ++i)
+        if (!sameChar(str[i], start[i]))
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Getting identifier and modification time of directory (in nanoseconds).
+// Directories on Windows have no identifier.
+
+static bool getDirInfo(const string& dir, TFileFinder::TDirId* pId, uint64_t* pTime)
+{
+    #if defined(OS_WINDOWS)
+        struct _stat64 Stat;
+        if (_stat64((dir + ".").c_str(), &Stat) != 0)
+            return false;
+        *pId = TFileFinder::TDirId(0, 0);
+        *pTime = static_cast<uint64_t>(Stat.st_mtime) * 1000000000;
+    #elif defined(OS_LINUX)
+        struct stat Stat;
+        if (stat(dir.c_str(), &Stat) != 0)
+            return false;
+        *pId = TFileFinder::TDirId(Stat.st_dev, Stat.st_ino);
+        *pTime = static_cast<uint64_t>(Stat.st_mtim.tv_sec) * 1000000000 + Stat.st_mtim.tv_nsec;
+    #else
+        #error "Unsupported OS."
+    #endif
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Getting lists of subdirectories and files of directory (in order of
+// directory entries), its identifier and modification time. Time is taken
+// before reading, so changes made during reading make it outdated. Symbolic
+// links to directories are skipped, so walk never loops through them.
+// On Linux entries are read with getdents64(): type of entry is taken from
+// d_type, and fstatat() relative to directory is called only for links and
+// entries of unknown type.
+
+#if defined(OS_LINUX)
+struct TDirEntry {
+    unsigned long long Inode;
+    long long          Offset;
+    unsigned short     Length;
+    unsigned char      Type;
+    char               Name[1];
+};
+#endif
+
+static void listDir(const string& dir, vector<string>* pDirs, vector<string>* pFiles, TFileFinder::TDirId* pId, uint64_t* pTime)
+{
+    *pId = TFileFinder::TDirId(0, 0);
+    *pTime = 0;
+
+    #if defined(OS_WINDOWS)
+        getDirInfo(dir, pId, pTime);
+        _finddata_t FindData;
+        intptr_t FindHandle = _findfirst((dir + "*").c_str(), &FindData);
+        if (FindHandle != -1) {
+            do {
+                if ((FindData.attrib & _A_SUBDIR) == 0)
+                    pFiles->push_back(FindData.name);
+                else if (strcmp(FindData.name, ".") != 0 && strcmp(FindData.name, "..") != 0)
+                    pDirs->push_back(FindData.name);
+            } while (_findnext(FindHandle, &FindData) == 0);
+            _findclose(FindHandle);
+        }
+    #elif defined(OS_LINUX)
+        const int Fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (Fd == -1)
+            return;
+
+        struct stat Stat;
+        if (fstat(Fd, &Stat) == 0) {
+            *pId = TFileFinder::TDirId(Stat.st_dev, Stat.st_ino);
+            *pTime = static_cast<uint64_t>(Stat.st_mtim.tv_sec) * 1000000000 + Stat.st_mtim.tv_nsec;
+        }
+
+        unsigned long long Buffer[4096];
+        long Size;
+        while ((Size = syscall(SYS_getdents64, Fd, Buffer, sizeof(Buffer))) > 0) {
+            for (long Pos = 0; Pos < Size; ) {
+                const TDirEntry* const pEntry =
+                    reinterpret_cast<const TDirEntry*>(reinterpret_cast<const char*>(Buffer) + Pos);
+                Pos += pEntry->Length;
+
+                const char* const Name = pEntry->Name;
+                if (Name[0] == '.' && (Name[1] == '\0' || (Name[1] == '.' && Name[2] == '\0')))
+                    continue;
+
+                unsigned char Type = pEntry->Type;
+                if (Type == DT_UNKNOWN) {
+                    if (fstatat(Fd, Name, &Stat, AT_SYMLINK_NOFOLLOW) != 0)
+                        continue;
+                    Type = S_ISDIR(Stat.st_mode) ? DT_DIR : S_ISLNK(Stat.st_mode) ? DT_LNK : DT_REG;
+                }
+                if (Type == DT_LNK) {
+                    if (fstatat(Fd, Name, &Stat, 0) == 0 && S_ISDIR(Stat.st_mode))
+                        continue;
+                    Type = DT_REG;
+                }
+
+                if (Type == DT_DIR)
+                    pDirs->push_back(Name);
+                else
+                    pFiles->push_back(Name);
+            }
+        }
+        close(Fd);
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TGlob::TGlob(const string& mask)
+    : m_Mask(mask),
+      m_HasStar(mask.find('*') != string::npos)
+{
+    size_t Start = 0;
+    for (size_t Pos; (Pos = mask.find('*', Start)) != string::npos; Start = Pos + 1)
+        m_Parts.push_back(mask.substr(Start, Pos - Start));
+    m_Parts.push_back(mask.substr(Start));
+}
+
+//------------------------------------------------------------------------------
+// Comparing beginning of name with part of mask without '*'.
+
+bool TGlob::matchPart(const char* name, const string& part)
+{
+    for (size_t i = 0; i < part.length(); ++i)
+        if (part[i] != '?' && !sameChar(name[i], part[i]))
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool TGlob::match(const char* name) const
+{
+    #if !defined(OS_WINDOWS)
+        if (name[0] == '.' && (m_Mask.empty() || m_Mask[0] != '.'))
+            return false;
+    #endif
+
+    const size_t Length = strlen(name);
+    const string& First = m_Parts.front();
+    if (!m_HasStar)
+        return Length == First.length() && matchPart(name, First);
+
+    const string& Last = m_Parts.back();
+    if (Length < First.length() + Last.length() ||
+        !matchPart(name, First) ||
+        !matchPart(name + Length - Last.length(), Last))
+        return false;
+
+    // Parts between stars are searched from left to right, each one as
+    // early as possible.
+    const char* p = name + First.length();
+    const char* const End = name + Length - Last.length();
+    for (size_t i = 1; i + 1 < m_Parts.size(); ++i) {
+        const string& Part = m_Parts[i];
+        while (p + Part.length() <= End && !matchPart(p, Part))
+            ++p;
+        if (p + Part.length() > End)
+            return false;
+        p += Part.length();
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TFileFinder::TElement::TElement(const string& dir, const string& mask, bool recursive)
+    : Dir(dir),
+      Glob(mask),
+      Recursive(recursive)
+{
+    if (Dir.empty() || Dir[Dir.length() - 1] != '/')
+        Dir += '/';
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TFileFinder::TDir::TDir()
+    : Id(0, 0),
+      Time(0)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+void TFileFinder::add(const string& dir, const string& mask, bool recursive)
+{
+    m_Elements.push_back(TElement(dir, mask, recursive));
+}
+
+//------------------------------------------------------------------------------
+// Files of directory are matched against mask of element. On Linux recursive
+// search descends only into subdirectories matched by mask, as glob() of
+// mask did.
+
+bool TFileFinder::isElementDir(const TElement& element, const string& dir) const
+{
+    if (!startsWith(dir, element.Dir))
+        return false;
+    if (dir.length() == element.Dir.length())
+        return true;
+    if (!element.Recursive)
+        return false;
+
+    #if defined(OS_LINUX)
+        for (string::size_type Begin = element.Dir.length(); Begin < dir.length(); ) {
+            const string::size_type End = dir.find('/', Begin);
+            if (!element.Glob.match(dir.substr(Begin, End - Begin)))
+                return false;
+            Begin = End + 1;
+        }
+    #endif
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Directory must be walked if it belongs to some element or is on the way to
+// directory of some element.
+
+bool TFileFinder::isDirNeeded(const string& dir) const
+{
+    for (TElements::const_iterator Iter = m_Elements.begin(); Iter != m_Elements.end(); ++Iter)
+        if (isElementDir(*Iter, dir) || startsWith(Iter->Dir, dir))
+            return true;
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Reading of directory: needed subdirectories are remembered, files are
+// matched against masks of elements. Only matched files are sorted.
+
+void TFileFinder::scanDir(const string& dir, TDir* pDir) const
+{
+    vector<string> Dirs, Files;
+    listDir(dir, &Dirs, &Files, &pDir->Id, &pDir->Time);
+
+    pDir->Path = dir;
+    for (vector<string>::const_iterator Iter = Dirs.begin(); Iter != Dirs.end(); ++Iter)
+        if (isDirNeeded(dir + *Iter + '/'))
+            pDir->SubDirs.push_back(*Iter);
+
+    for (size_t i = 0; i < m_Elements.size(); ++i)
+        if (isElementDir(m_Elements[i], dir))
+            for (vector<string>::const_iterator Iter = Files.begin(); Iter != Files.end(); ++Iter)
+                if (m_Elements[i].Glob.match(*Iter))
+                    pDir->Files.push_back(make_pair(i, *Iter));
+    sort(pDir->Files.begin(), pDir->Files.end());
+}
+
+//------------------------------------------------------------------------------
+// Inventory is valid only for the same elements (relative to root).
+
+uint64_t TFileFinder::fingerprint(const string& root) const
+{
+    uint64_t Hash = Functions::hash(NULL, 0);
+    for (TElements::const_iterator Iter = m_Elements.begin(); Iter != m_Elements.end(); ++Iter) {
+        const string Element = Iter->Dir.substr(root.length()) + '\0' + Iter->Glob.mask() + '\0' +
+                               (Iter->Recursive ? 'r' : 'n');
+        Hash = Functions::hash(Element.data(), Element.length() + 1, Hash);
+    }
+    return Hash;
+}
+
+//------------------------------------------------------------------------------
+// Order of directories in recursive walk: subdirectories sorted by name go
+// before their parent.
+
+bool TFileFinder::isWalkOrder(const TDir& dir1, const TDir& dir2)
+{
+    const string& Path1 = dir1.Path;
+    const string& Path2 = dir2.Path;
+    size_t i = 0;
+    while (i < Path1.length() && i < Path2.length() && Path1[i] == Path2[i])
+        ++i;
+
+    // Paths end with '/', so the whole path is the name of parent directory.
+    if (i == Path2.length())
+        return i < Path1.length();
+    if (i == Path1.length())
+        return false;
+    if (Path1[i] == '/')
+        return true;
+    if (Path2[i] == '/')
+        return false;
+    return static_cast<unsigned char>(Path1[i]) < static_cast<unsigned char>(Path2[i]);
+}
+
+//------------------------------------------------------------------------------
+// Order of files found by glob() on Linux: files and subdirectories of
+// directory are sorted by name together.
+
+bool TFileFinder::isGlobOrder(const string& path1, const string& path2)
+{
+    size_t i = 0;
+    while (i < path1.length() && i < path2.length() && path1[i] == path2[i])
+        ++i;
+
+    if (i == path2.length())
+        return false;
+    if (i == path1.length())
+        return true;
+    // Name ending at separator is less than any longer name.
+    const unsigned char Char1 = path1[i] == '/' ? 0 : static_cast<unsigned char>(path1[i]);
+    const unsigned char Char2 = path2[i] == '/' ? 0 : static_cast<unsigned char>(path2[i]);
+    return Char1 < Char2;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// Job of walking of directory tree. Every thread runs one job with its own
+// queue of directories.
+
+class TFileFinder::TWalkJob : public TThreadPool::TJob
+{
+    private :
+        struct TQueue {
+            TMutex        Mutex;
+            deque<string> Dirs;
+        };
+
+        const TFileFinder& m_Finder;
+        const std::string  m_Root;
+        const TInventory*  m_pInventory;
+        const size_t       m_Count;
+        TQueue*            m_Queues;
+        vector<TDirs>      m_Dirs;
+        size_t             m_Pending;
+        size_t             m_Queued;
+        set<TDirId>        m_Visited;
+        TMutex             m_Mutex;
+        TCondition         m_Condition;
+
+        TWalkJob(const TWalkJob&);
+        TWalkJob& operator=(const TWalkJob&);
+
+        void push(size_t index, const string& dir);
+        bool take(size_t index, string* pDir);
+        void done();
+        bool wait();
+        bool visit(const TDirId& id);
+        void readDir(const string& dir, TDir* pDir) const;
+
+    public :
+        TWalkJob(const TFileFinder& finder, const string& root, const TInventory* pInventory, size_t count);
+        virtual ~TWalkJob();
+        virtual bool run(size_t index);
+        void getDirs(TDirs* pDirs) const;
+};
+
+//------------------------------------------------------------------------------
+
+TFileFinder::TWalkJob::TWalkJob(const TFileFinder& finder, const string& root, const TInventory* pInventory, size_t count)
+    : m_Finder(finder),
+      m_Root(root),
+      m_pInventory(pInventory),
+      m_Count(count),
+      m_Queues(new TQueue[count]),
+      m_Dirs(count),
+      m_Pending(0),
+      m_Queued(0)
+{
+    push(0, root);
+}
+
+//------------------------------------------------------------------------------
+
+TFileFinder::TWalkJob::~TWalkJob()
+{
+    delete[] m_Queues;
+}
+
+//------------------------------------------------------------------------------
+// Number of pending directories (queued or being read) is counted, walk is
+// finished when it becomes zero. Queued directories are counted separately
+// to wake idle threads.
+
+void TFileFinder::TWalkJob::push(size_t index, const string& dir)
+{
+    {
+        TMutexLocker Locker(m_Queues[index].Mutex);
+        m_Queues[index].Dirs.push_back(dir);
+    }
+    TMutexLocker Locker(m_Mutex);
+    ++m_Pending;
+    ++m_Queued;
+    m_Condition.wakeOne();
+}
+
+//------------------------------------------------------------------------------
+
+void TFileFinder::TWalkJob::done()
+{
+    TMutexLocker Locker(m_Mutex);
+    if (--m_Pending == 0)
+        m_Condition.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+// Waits for queued directory. Returns false if walk is finished.
+
+bool TFileFinder::TWalkJob::wait()
+{
+    TMutexLocker Locker(m_Mutex);
+    while (m_Pending != 0 && m_Queued == 0)
+        m_Condition.wait(m_Mutex);
+    return m_Pending != 0;
+}
+
+//------------------------------------------------------------------------------
+// Own queue is used as stack (the last added directory is read first), other
+// queues are robbed from the other end, where directories are closer to the
+// root and have bigger subtrees.
+
+bool TFileFinder::TWalkJob::take(size_t index, string* pDir)
+{
+    for (size_t i = 0; i < m_Count; ++i) {
+        TQueue& Queue = m_Queues[(index + i) % m_Count];
+        TMutexLocker Locker(Queue.Mutex);
+        if (!Queue.Dirs.empty()) {
+            if (i == 0) {
+                *pDir = Queue.Dirs.back();
+                Queue.Dirs.pop_back();
+            }
+            else {
+                *pDir = Queue.Dirs.front();
+                Queue.Dirs.pop_front();
+            }
+            TMutexLocker CountLocker(m_Mutex);
+            --m_Queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Returns false if directory was visited already. Directories without
+// identifier (on Windows) are always new.
+
+bool TFileFinder::TWalkJob::visit(const TDirId& id)
+{
+    if (id.first == 0 && id.second == 0)
+        return true;
+    TMutexLocker Locker(m_Mutex);
+    return m_Visited.insert(id).second;
+}
+
+//------------------------------------------------------------------------------
+// Directory is taken from inventory if it was not modified since the last
+// walk, otherwise it is read.
+
+void TFileFinder::TWalkJob::readDir(const string& dir, TDir* pDir) const
+{
+    if (m_pInventory != NULL &&
+        getDirInfo(dir, &pDir->Id, &pDir->Time) &&
+        m_pInventory->find(dir.substr(m_Root.length()), pDir))
+    {
+        pDir->Path = dir;
+        return;
+    }
+    *pDir = TDir();
+    m_Finder.scanDir(dir, pDir);
+}
+
+//------------------------------------------------------------------------------
+
+bool TFileFinder::TWalkJob::run(size_t index)
+{
+    string Dir;
+    while (wait()) {
+        if (!take(index, &Dir))
+            continue;
+        m_Dirs[index].push_back(TDir());
+        TDir& NewDir = m_Dirs[index].back();
+        readDir(Dir, &NewDir);
+        if (!visit(NewDir.Id)) {
+            m_Dirs[index].pop_back();
+        }
+        else {
+            for (vector<string>::const_iterator Iter = NewDir.SubDirs.begin(); Iter != NewDir.SubDirs.end(); ++Iter)
+                push(index, Dir + *Iter + '/');
+        }
+        done();
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void TFileFinder::TWalkJob::getDirs(TDirs* pDirs) const
+{
+    for (size_t i = 0; i < m_Dirs.size(); ++i)
+        pDirs->insert(pDirs->end(), m_Dirs[i].begin(), m_Dirs[i].end());
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// Walking begins in the deepest directory common for all elements. Found
+// directories are sorted in order of recursive walk, and files are grouped
+// by elements. Inventory is saved after walk if directories were changed.
+
+TStringList TFileFinder::find(unsigned int threadCount)
+{
+    TStringList Result;
+    if (m_Elements.empty())
+        return Result;
+    if (threadCount < 1)
+        threadCount = 1;
+
+    string Root = m_Elements.front().Dir;
+    for (TElements::const_iterator Iter = m_Elements.begin() + 1; Iter != m_Elements.end(); ++Iter) {
+        size_t Length = 0;
+        while (Length < Root.length() && Length < Iter->Dir.length() &&
+               sameChar(Root[Length], Iter->Dir[Length]))
+            ++Length;
+        Root.resize(Length);
+    }
+    Root.resize(Root.rfind('/') + 1);
+
+    TInventory Inventory(m_InventoryFileName, fingerprint(Root));
+    const bool UseInventory = !m_InventoryFileName.empty() && Inventory.load();
+
+    TDirs Dirs;
+    {
+        TWalkJob Job(*this, Root, UseInventory ? &Inventory : NULL, threadCount);
+        TThreadPool::run(&Job, threadCount, threadCount);
+        Job.getDirs(&Dirs);
+    }
+    const bool IsSaved = UseInventory && Inventory.isSaved(Root, Dirs);
+    Inventory.close();
+    sort(Dirs.begin(), Dirs.end(), isWalkOrder);
+    if (!m_InventoryFileName.empty()) {
+        if (IsSaved) {
+            LOG_V("Inventory \"%s\" is up to date.\n", m_InventoryFileName.c_str());
+        }
+        else {
+            Inventory.save(Root, Dirs);
+        }
+    }
+
+    vector<TStringList> Results(m_Elements.size());
+    for (TDirs::const_iterator Dir = Dirs.begin(); Dir != Dirs.end(); ++Dir)
+        for (size_t i = 0; i < Dir->Files.size(); ++i)
+            Results[Dir->Files[i].first].push_back(Dir->Path + Dir->Files[i].second);
+    for (size_t i = 0; i < Results.size(); ++i) {
+        #if defined(OS_LINUX)
+            if (m_Elements[i].Recursive)
+                Results[i].sort(isGlobOrder);
+        #endif
+        Result.splice(Result.end(), Results[i]);
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
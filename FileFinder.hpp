@@ -0,0 +1,134 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_FILEFINDER__
+#define __QTBINPATCHER2_FILEFINDER__
+
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+
+#include "CommonTypes.hpp"
+
+//------------------------------------------------------------------------------
+// File name mask with wildcards '*' and '?' compiled into literal parts.
+// On Windows matching is case-insensitive; on Linux wildcards don't match
+// leading dot of name (as in glob()).
+
+class TGlob
+{
+    private :
+        std::string m_Mask;
+        std::vector<std::string> m_Parts;   // Parts between '*'.
+        bool m_HasStar;
+
+        static bool matchPart(const char* name, const std::string& part);
+
+    public :
+        explicit TGlob(const std::string& mask);
+
+        bool match(const char* name) const;
+        inline bool match(const std::string& name) const
+            { return match(name.c_str()); }
+        inline const std::string& mask() const
+            { return m_Mask; }
+};
+
+//------------------------------------------------------------------------------
+// Searching of files by several masks in one walk of directory tree. Each
+// mask is searched in its directory, and in subdirectories if mask is
+// recursive (on Linux only in subdirectories matched by mask, as glob() did).
+// Directories are walked only if some mask needs them.
+// Directories are read in several threads: each thread takes directories
+// from its own queue and steals them from queues of other threads when its
+// queue is empty. Directories are visited once (by device and inode), so
+// loops of links or bind mounts don't hang the walk.
+// Directories of the tree may be remembered in inventory file: on the next
+// search directories with the same modification time are not read again.
+// Result is the same as of separate searching for each mask in order of
+// adding: in every directory files of subdirectories go first (subdirectories
+// and files are sorted by name); on Linux files and subdirectories are sorted
+// together, as glob() sorted them. Entries of directories are not sorted, only
+// found directories and matched files are.
+
+class TFileFinder
+{
+    public :
+        typedef std::pair<unsigned long long, unsigned long long> TDirId;
+
+        // Directory read by walk: needed subdirectories and files found by
+        // elements (numbers of elements and names).
+        struct TDir {
+            std::string Path;
+            TDirId      Id;
+            uint64_t    Time;
+            std::vector<std::string> SubDirs;
+            std::vector<std::pair<size_t, std::string> > Files;
+
+            TDir();
+        };
+        typedef std::vector<TDir> TDirs;
+
+    private :
+        struct TElement {
+            std::string Dir;
+            TGlob       Glob;
+            bool        Recursive;
+
+            TElement(const std::string& dir, const std::string& mask, bool recursive);
+        };
+        typedef std::vector<TElement> TElements;
+
+        class TWalkJob;
+
+        TElements   m_Elements;
+        std::string m_InventoryFileName;
+
+        static bool isWalkOrder(const TDir& dir1, const TDir& dir2);
+        static bool isGlobOrder(const std::string& path1, const std::string& path2);
+        bool isDirNeeded(const std::string& dir) const;
+        bool isElementDir(const TElement& element, const std::string& dir) const;
+        void scanDir(const std::string& dir, TDir* pDir) const;
+        uint64_t fingerprint(const std::string& root) const;
+
+    public :
+        void add(const std::string& dir, const std::string& mask, bool recursive);
+        TStringList find(unsigned int threadCount = 1);
+
+        inline void setInventory(const std::string& fileName)
+            { m_InventoryFileName = fileName; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_FILEFINDER__
@@ -35,10 +35,19 @@
 #include <string.h>
 #include <errno.h>
 #if defined(OS_WINDOWS)
+    #include <windows.h>
     #include <io.h>
     #include <direct.h>
+    #include <sys/types.h>
+    #include <sys/stat.h>
 #elif defined(OS_LINUX)
     #include <sys/stat.h>
+    #include <sys/ioctl.h>
+    #include <sys/sendfile.h>
+    #include <sys/syscall.h>
+    #include <sys/xattr.h>
+    #include <linux/fs.h>
+    #include <fcntl.h>
     #include <unistd.h>
     #include <glob.h>
     #include <limits.h>
@@ -244,12 +253,12 @@ bool Functions::isFileExists(const char* fileName)
 }
 
 //------------------------------------------------------------------------------
-// Getting size of opened file.
+// Getting size of opened file. Returns -1 on error.
 
-long Functions::getFileSize(FILE* file)
+int64_t Functions::getFileSize(FILE* file)
 {
     #if defined(OS_WINDOWS)
-        return _filelength(_fileno(file));
+        return _filelengthi64(_fileno(file));
     #elif defined(OS_LINUX)
         struct stat Stat;
         if (fstat(fileno(file), &Stat) == 0)
@@ -260,6 +269,77 @@ long Functions::getFileSize(FILE* file)
     #endif
 }
 
+//------------------------------------------------------------------------------
+// Getting size, modification time and inode of file. Time is in nanoseconds
+// (with precision of seconds on Windows) and is used only for comparison.
+// Inode is always zero on Windows.
+
+bool Functions::getFileInfo(const char* fileName, uint64_t* pSize, uint64_t* pTime, uint64_t* pInode)
+{
+    #if defined(OS_WINDOWS)
+        struct __stat64 Stat;
+        if (_stat64(fileName, &Stat) != 0)
+            return false;
+        *pTime = static_cast<uint64_t>(Stat.st_mtime) * 1000000000u;
+        if (pInode != NULL)
+            *pInode = 0;
+    #elif defined(OS_LINUX)
+        struct stat Stat;
+        if (stat(fileName, &Stat) != 0)
+            return false;
+        *pTime = static_cast<uint64_t>(Stat.st_mtim.tv_sec) * 1000000000u + Stat.st_mtim.tv_nsec;
+        if (pInode != NULL)
+            *pInode = static_cast<uint64_t>(Stat.st_ino);
+    #else
+        #error "Unsupported OS."
+    #endif
+    *pSize = static_cast<uint64_t>(Stat.st_size);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Checking that file or directory was modified less than 2 seconds ago (time
+// is in nanoseconds). Such times are not saved into caches: the next change may
+// not change the time.
+
+bool Functions::isFreshTime(uint64_t fileTime)
+{
+    return fileTime + 2000000000ull >= static_cast<uint64_t>(time(NULL)) * 1000000000u;
+}
+
+//------------------------------------------------------------------------------
+// Setting position in opened file. Offset may be greater than 2 GB on hosts
+// with 32-bit long.
+
+bool Functions::seekFile(FILE* file, uint64_t offset)
+{
+    #if defined(OS_WINDOWS)
+        return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+    #elif defined(OS_LINUX)
+        return fseeko64(file, static_cast<off64_t>(offset), SEEK_SET) == 0;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Getting position in opened file (64-bit, as in seekFile()).
+
+bool Functions::tellFile(FILE* file, uint64_t* pOffset)
+{
+    #if defined(OS_WINDOWS)
+        const __int64 Offset = _ftelli64(file);
+    #elif defined(OS_LINUX)
+        const off64_t Offset = ftello64(file);
+    #else
+        #error "Unsupported OS."
+    #endif
+    if (Offset < 0)
+        return false;
+    *pOffset = static_cast<uint64_t>(Offset);
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // Truncation file to empty (zero size).
 
@@ -274,6 +354,39 @@ bool Functions::zeroFile(FILE* file)
         #error "Unsupported OS."
     #endif
 }
+//------------------------------------------------------------------------------
+// Changing size of opened file (buffered data is written before).
+
+bool Functions::resizeFile(FILE* file, uint64_t size)
+{
+    if (fflush(file) != 0)
+        return false;
+    #if defined(OS_WINDOWS)
+        return _chsize_s(_fileno(file), static_cast<__int64>(size)) == 0;
+    #elif defined(OS_LINUX)
+        return ftruncate64(fileno(file), static_cast<off64_t>(size)) == 0;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Writing buffered data of opened file to disk. Metadata is synced only if
+// it is needed to read the data (size of file).
+
+bool Functions::syncFile(FILE* file)
+{
+    if (fflush(file) != 0)
+        return false;
+    #if defined(OS_WINDOWS)
+        return _commit(_fileno(file)) == 0;
+    #elif defined(OS_LINUX)
+        return fdatasync(fileno(file)) == 0;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
 //------------------------------------------------------------------------------
 
 bool Functions::renameFile(const char* oldFileName, const char* newFileName)
@@ -291,6 +404,131 @@ bool Functions::renameFile(const char* oldFileName, const char* newFileName)
 }
 
 //------------------------------------------------------------------------------
+// Copying of data range between files. Methods are tried from the fastest:
+// copy_file_range() copies inside file system (or even shares extents),
+// sendfile() copies inside kernel, and the last one is user-space buffer.
+// Method is lowered when the faster one is not supported for these files.
+
+#if defined(OS_LINUX)
+#ifndef FICLONE
+    #define FICLONE _IOW(0x94, 9, int)
+#endif
+
+enum TCopyMethod {
+    cmCopyFileRange,
+    cmSendFile,
+    cmBuffer
+};
+
+static bool copyRange(int src, int dst, off_t offset, off_t size, TCopyMethod* pMethod)
+{
+    while (size > 0) {
+        const size_t Count = size > 0x40000000 ? 0x40000000 : static_cast<size_t>(size);
+        ssize_t Copied = -1;
+        if (*pMethod == cmCopyFileRange) {
+            #if defined(SYS_copy_file_range)
+                loff_t InOffset = offset, OutOffset = offset;
+                Copied = syscall(SYS_copy_file_range, src, &InOffset, dst, &OutOffset, Count, 0);
+            #else
+                errno = ENOSYS;
+            #endif
+            if (Copied <= 0) {
+                if (Copied == 0 || errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                    errno == EOPNOTSUPP || errno == EPERM)
+                {
+                    *pMethod = cmSendFile;
+                    continue;
+                }
+                return false;
+            }
+        }
+        else if (*pMethod == cmSendFile) {
+            off_t InOffset = offset;
+            if (lseek(dst, offset, SEEK_SET) == static_cast<off_t>(-1))
+                return false;
+            Copied = sendfile(dst, src, &InOffset, Count);
+            if (Copied <= 0) {
+                if (Copied == 0 || errno == EINVAL || errno == ENOSYS) {
+                    *pMethod = cmBuffer;
+                    continue;
+                }
+                return false;
+            }
+        }
+        else {
+            char Buffer[1024*32];  // 32kb
+            Copied = pread(src, Buffer, Count < sizeof(Buffer) ? Count : sizeof(Buffer), offset);
+            if (Copied <= 0)
+                return false;
+            for (ssize_t Written = 0, Pos = 0; Pos < Copied; Pos += Written) {
+                Written = pwrite(dst, Buffer + Pos, Copied - Pos, offset + Pos);
+                if (Written <= 0)
+                    return false;
+            }
+        }
+        offset += Copied;
+        size -= Copied;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Copying of file content. Copy shares data with source (reflink) if file
+// system can do it. Otherwise only data regions of source are copied, so
+// holes of sparse files stay holes.
+
+static bool copyFileContent(int src, int dst, off_t size)
+{
+    if (ioctl(dst, FICLONE, src) == 0)
+        return true;
+
+    TCopyMethod Method = cmCopyFileRange;
+    for (off_t Offset = 0; Offset < size; ) {
+        off_t DataStart = lseek(src, Offset, SEEK_DATA);
+        off_t DataEnd = size;
+        if (DataStart == static_cast<off_t>(-1)) {
+            if (errno == ENXIO)
+                break;
+            DataStart = Offset;
+        }
+        else {
+            DataEnd = lseek(src, DataStart, SEEK_HOLE);
+            if (DataEnd == static_cast<off_t>(-1) || DataEnd > size)
+                DataEnd = size;
+        }
+        if (!copyRange(src, dst, DataStart, DataEnd - DataStart, &Method))
+            return false;
+        Offset = DataEnd;
+    }
+    return ftruncate(dst, size) == 0;
+}
+
+//------------------------------------------------------------------------------
+// Copying of extended attributes (ACL, capabilities, SELinux labels). Some
+// attributes may be unsupported by file system or need privileges; such
+// attributes are skipped.
+
+static void copyXattrs(int src, int dst, const char* fileName)
+{
+    const ssize_t ListSize = flistxattr(src, NULL, 0);
+    if (ListSize <= 0)
+        return;
+    vector<char> List(ListSize);
+    const ssize_t Size = flistxattr(src, List.data(), List.size());
+    for (ssize_t i = 0; i < Size; i += strlen(&List[i]) + 1) {
+        const char* const Name = &List[i];
+        const ssize_t ValueSize = fgetxattr(src, Name, NULL, 0);
+        vector<char> Value(ValueSize > 0 ? ValueSize : 1);
+        const ssize_t Length = fgetxattr(src, Name, Value.data(), Value.size());
+        if (Length < 0 || fsetxattr(dst, Name, Value.data(), Length, 0) != 0)
+            LOG_V("Can't copy attribute \"%s\" of file \"%s\". Error %i.\n", Name, fileName, errno);
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+// Copy keeps mode (attributes) of the source file. On Linux owner and
+// extended attributes are kept too, if it is permitted.
 
 bool Functions::copyFile(const char* fromFileName, const char* toFileName)
 {
@@ -298,37 +536,208 @@ bool Functions::copyFile(const char* fromFileName, const char* toFileName)
           "                       to \"%s\".\n",
           fromFileName, toFileName);
 
-    bool Result = true;
-    FILE* src = fopen(fromFileName, "rb");
-    if (src != NULL) {
-        FILE* dst = fopen(toFileName, "wb");
-        if (dst != NULL) {
-            char Buffer[1024*32];  // 32kb
-            while (!feof(src)) {
-                size_t size = fread(Buffer, 1, sizeof(Buffer), src);
-                if (fwrite(Buffer, 1, size, dst) != size) {
-                    LOG_E("Error writing to file \"%s\".\n", toFileName);
-                    Result = false;
-                    break;
-                }
-            }
-            fclose(dst);
-            if (!Result)
-                removeFile(toFileName);
+    #if defined(OS_WINDOWS)
+        if (CopyFileA(fromFileName, toFileName, FALSE) == 0) {
+            LOG_E("Error copying file \"%s\" to \"%s\". Error %lu.\n",
+                  fromFileName, toFileName, GetLastError());
+            return false;
         }
-        else {
-            LOG_E("Error opening file \"%s\" for writing.\n", toFileName);
+        return true;
+    #elif defined(OS_LINUX)
+        const int Src = open(fromFileName, O_RDONLY | O_CLOEXEC);
+        struct stat Stat;
+        if (Src == -1 || fstat(Src, &Stat) != 0) {
+            LOG_E("Error opening file \"%s\" for reading. Error %i.\n", fromFileName, errno);
+            if (Src != -1)
+                close(Src);
+            return false;
+        }
+
+        const int Dst = open(toFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, Stat.st_mode & 07777);
+        if (Dst == -1) {
+            LOG_E("Error opening file \"%s\" for writing. Error %i.\n", toFileName, errno);
+            close(Src);
+            return false;
+        }
+
+        // Attributes are set after content: writing clears set-user-ID bit
+        // and capabilities. Owner is changed before mode for the same reason.
+        bool Result = copyFileContent(Src, Dst, Stat.st_size);
+        if (Result) {
+            if (fchown(Dst, Stat.st_uid, Stat.st_gid) != 0)
+                LOG_V("Can't change owner of file \"%s\". Error %i.\n", toFileName, errno);
+            copyXattrs(Src, Dst, toFileName);
+            Result = fchmod(Dst, Stat.st_mode & 07777) == 0;
+        }
+        if (!Result)
+            LOG_E("Error writing to file \"%s\". Error %i.\n", toFileName, errno);
+        if (close(Dst) != 0)
             Result = false;
+        close(Src);
+        if (!Result)
+            removeFile(toFileName);
+        return Result;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Creating hard link to file (the second name for the same file content).
+
+bool Functions::linkFile(const char* fileName, const char* linkName)
+{
+    LOG_V("Linking file \"%s\"\n"
+          "          to \"%s\".\n",
+          fileName, linkName);
+
+    #if defined(OS_WINDOWS)
+        if (CreateHardLinkA(linkName, fileName, NULL) == 0) {
+            LOG_V("Error linking file \"%s\" to \"%s\". Error %lu.\n",
+                  fileName, linkName, GetLastError());
+            return false;
         }
-        fclose(src);
+    #elif defined(OS_LINUX)
+        if (link(fileName, linkName) != 0) {
+            LOG_V("Error linking file \"%s\" to \"%s\". Error %i.\n",
+                  fileName, linkName, errno);
+            return false;
+        }
+    #else
+        #error "Unsupported OS."
+    #endif
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Reading of the whole file into buffer.
+
+bool Functions::readFile(const char* fileName, vector<char>* pBuf)
+{
+    pBuf->clear();
+    FILE* File = fopen(fileName, "rb");
+    if (File == NULL) {
+        LOG_E("Error opening file \"%s\" for reading. Error %i.\n", fileName, errno);
+        return false;
+    }
+
+    const int64_t FileLength = getFileSize(File);
+    bool Result = FileLength >= 0;
+    if (Result && FileLength > 0) {
+        pBuf->resize(static_cast<size_t>(FileLength));
+        Result = fread(pBuf->data(), pBuf->size(), 1, File) == 1;
+    }
+    fclose(File);
+
+    if (!Result) {
+        LOG_E("Error reading from file \"%s\".\n", fileName);
+        pBuf->clear();
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Name of temporary file used for writing of file in atomic mode.
+
+string Functions::tempFileName(const string& fileName)
+{
+    return fileName + ".qtbinpatcher.tmp";
+}
+
+//------------------------------------------------------------------------------
+// Errors of writing of optional files (caches) are logged only in verbose
+// mode.
+
+static void logWriteError(bool optional, const char* format, const string& fileName)
+{
+    const int Error = errno;
+    if (!optional) {
+        LOG_E(format, fileName.c_str(), Error);
     }
     else {
-        LOG_E("Error opening file \"%s\" for reading.\n", fromFileName);
-        Result = false;
+        LOG_V(format, fileName.c_str(), Error);
     }
+}
+
+//------------------------------------------------------------------------------
+// Syncing of directory of the file. On Linux renaming of file is durable only
+// after that; on Windows MoveFileEx() writes it through itself.
 
+#if defined(OS_LINUX)
+static bool syncFileDir(const string& fileName)
+{
+    const string::size_type Pos = fileName.rfind('/');
+    const string Dir = Pos == string::npos ? string(".") : fileName.substr(0, Pos == 0 ? 1 : Pos);
+    const int Fd = open(Dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (Fd < 0)
+        return false;
+    const bool Result = fsync(Fd) == 0;
+    close(Fd);
     return Result;
 }
+#endif
+
+//------------------------------------------------------------------------------
+// Writing new file content to temporary file near the file and replacing the
+// file by it. The file is never left partially written. Optional file is a
+// cache, which can be lost without harm.
+
+bool Functions::writeFileAtomic(const string& fileName, const char* data, size_t size, bool optional)
+{
+    const string TmpFileName = tempFileName(fileName);
+
+    FILE* File = fopen(TmpFileName.c_str(), "wb");
+    if (File == NULL) {
+        logWriteError(optional, "Error opening file \"%s\" for writing. Error %i.\n", TmpFileName);
+        return false;
+    }
+
+    bool Result = size == 0 || fwrite(data, size, 1, File) == 1;
+    if (Result)
+        Result = fflush(File) == 0;
+    #if defined(OS_WINDOWS)
+        if (Result)
+            Result = _commit(_fileno(File)) == 0;
+    #elif defined(OS_LINUX)
+        struct stat Stat;
+        if (Result && stat(fileName.c_str(), &Stat) == 0) {
+            if (fchown(fileno(File), Stat.st_uid, Stat.st_gid) != 0)
+                LOG_V("Can't change owner of file \"%s\". Error %i.\n", TmpFileName.c_str(), errno);
+            Result = fchmod(fileno(File), Stat.st_mode & 07777) == 0;
+        }
+        if (Result)
+            Result = fsync(fileno(File)) == 0;
+    #else
+        #error "Unsupported OS."
+    #endif
+    if (fclose(File) != 0)
+        Result = false;
+
+    if (!Result) {
+        logWriteError(optional, "Error writing to file \"%s\". Error %i.\n", TmpFileName);
+        remove(TmpFileName.c_str());
+        return false;
+    }
+
+    #if defined(OS_WINDOWS)
+        Result = MoveFileExA(TmpFileName.c_str(), fileName.c_str(),
+                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    #else
+        Result = rename(TmpFileName.c_str(), fileName.c_str()) == 0;
+    #endif
+    if (!Result) {
+        logWriteError(optional, "Error replacing file \"%s\". Error %i.\n", fileName);
+        remove(TmpFileName.c_str());
+        return false;
+    }
+    #if defined(OS_LINUX)
+        if (!syncFileDir(fileName)) {
+            logWriteError(optional, "Error syncing directory of file \"%s\". Error %i.\n", fileName);
+            return false;
+        }
+    #endif
+    return true;
+}
 
 //------------------------------------------------------------------------------
 
@@ -356,6 +765,18 @@ string Functions::currentTime(const char* format)
     return Buffer;
 }
 
+//------------------------------------------------------------------------------
+// FNV-1a hash. Can be calculated by parts: result of previous part is passed
+// as initial value of hash.
+
+uint64_t Functions::hash(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (const unsigned char* End = p + size; p < End; ++p)
+        hash = (hash ^ *p) * 1099511628211ull;
+    return hash;
+}
+
 //------------------------------------------------------------------------------
 
 std::string Functions::getProgramOutput(const char* fileName)
@@ -384,80 +805,6 @@ std::string Functions::getProgramOutput(const char* fileName)
 
 //------------------------------------------------------------------------------
 
-TStringList Functions::findFiles(string dir, const string& mask)
-{
-    TStringList Result;
-
-    addLastSeparator(&dir);
-
-    #if defined(OS_WINDOWS)
-        _finddata_t FindData;
-        intptr_t FindHandle = _findfirst((dir + mask).c_str(), &FindData);
-        if (FindHandle != -1) {
-            do {
-                if ((FindData.attrib & _A_SUBDIR) == 0)
-                    Result.push_back(dir + FindData.name);
-            } while (_findnext(FindHandle, &FindData) == 0);
-            _findclose(FindHandle);
-        }
-    #elif defined(OS_LINUX)
-        glob_t GlobData;
-        if (glob((dir + mask).c_str(), GLOB_MARK, NULL, &GlobData) == 0) {
-            for (size_t i = 0; i < GlobData.gl_pathc; ++i) {
-                const char* path = GlobData.gl_pathv[i];
-                if (path[strlen(path) -1] !=  '/')
-                    Result.push_back(path);
-            }
-            globfree(&GlobData);
-        }
-    #else
-        #error "Unsupported OS."
-    #endif
-
-    return Result;
-}
-
-//------------------------------------------------------------------------------
-
-TStringList Functions::findFilesRecursive(string dir, const string& mask)
-{
-    TStringList Result;
-
-    addLastSeparator(&dir);
-
-    #if defined (OS_WINDOWS)
-        _finddata_t FindData;
-        intptr_t FindHandle = _findfirst((dir + "*").c_str(), &FindData);
-        if (FindHandle != -1) {
-            do {
-                if ((FindData.attrib & _A_SUBDIR) != 0 &&
-                    strcmp(FindData.name, ".")  != 0   &&
-                    strcmp(FindData.name, "..") != 0)
-                {
-                    splice(&Result, findFilesRecursive(dir + FindData.name + "/", mask));
-                }
-            } while (_findnext(FindHandle, &FindData) == 0);
-            _findclose(FindHandle);
-        }
-        splice(&Result, findFiles(dir, mask));
-    #elif defined (OS_LINUX)
-        glob_t GlobData;
-        if (glob((dir + mask).c_str(), GLOB_MARK, NULL, &GlobData) == 0) {
-            for (size_t i = 0; i < GlobData.gl_pathc; ++i) {
-                const char* path = GlobData.gl_pathv[i];
-                if (path[strlen(path) - 1] != '/')
-                    Result.push_back(path);
-                else
-                   splice(&Result, findFilesRecursive(path, mask));
-            }
-        }
-    #endif
-
-    return Result;
-}
-
-//------------------------------------------------------------------------------
-
 string Functions::stringListToStr(const TStringList& list, const string& prefix, const string& suffix)
 {
     string Result;
@@ -34,6 +34,9 @@
 
 //------------------------------------------------------------------------------
 
+#include <stdint.h>
+#include <vector>
+
 #include "CommonTypes.hpp"
 
 //------------------------------------------------------------------------------
@@ -50,15 +53,24 @@ namespace Functions {
     std::string absolutePath(const std::string& relativePath);
     std::string currentDir();
     bool isFileExists(const char* fileName);
-    long getFileSize(FILE* file);
+    int64_t getFileSize(FILE* file);
+    bool getFileInfo(const char* fileName, uint64_t* pSize, uint64_t* pTime, uint64_t* pInode = NULL);
+    bool isFreshTime(uint64_t fileTime);
+    bool seekFile(FILE* file, uint64_t offset);
+    bool tellFile(FILE* file, uint64_t* pOffset);
     bool zeroFile(FILE* file);
+    bool resizeFile(FILE* file, uint64_t size);
+    bool syncFile(FILE* file);
     bool renameFile(const char* oldFileName, const char* newFileName);
     bool copyFile(const char* fromFileName, const char* toFileName);
+    bool linkFile(const char* fileName, const char* linkName);
+    bool readFile(const char* fileName, std::vector<char>* pBuf);
+    std::string tempFileName(const std::string& fileName);
+    bool writeFileAtomic(const std::string& fileName, const char* data, size_t size, bool optional = false);
     bool removeFile(const char* fileName);
     std::string getProgramOutput(const char* fileName);
     std::string currentTime(const char* format);
-    TStringList findFiles(std::string dir, const std::string& mask);
-    TStringList findFilesRecursive(std::string dir, const std::string& mask);
+    uint64_t hash(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
     std::string stringListToStr(const TStringList& list, const std::string& prefix, const std::string& suffix);
     std::string stringMapToStr(const TStringMap& map, const std::string& prefix, const std::string& separator, const std::string& suffix);
 
@@ -73,12 +85,21 @@ namespace Functions {
     inline bool isFileExists(const std::string& fileName)
         { return isFileExists(fileName.c_str()); }
 
+    inline bool getFileInfo(const std::string& fileName, uint64_t* pSize, uint64_t* pTime, uint64_t* pInode = NULL)
+        { return getFileInfo(fileName.c_str(), pSize, pTime, pInode); }
+
     inline bool renameFile(const std::string& oldFileName, const std::string& newFileName)
         { return renameFile(oldFileName.c_str(), newFileName.c_str()); }
 
     inline bool copyFile(const std::string& fromFileName, const std::string& toFileName)
         { return copyFile(fromFileName.c_str(), toFileName.c_str()); }
 
+    inline bool linkFile(const std::string& fileName, const std::string& linkName)
+        { return linkFile(fileName.c_str(), linkName.c_str()); }
+
+    inline bool readFile(const std::string& fileName, std::vector<char>* pBuf)
+        { return readFile(fileName.c_str(), pBuf); }
+
     inline bool removeFile(const std::string& fileName)
         { return removeFile(fileName.c_str()); }
 
@@ -0,0 +1,356 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "Inventory.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char     InventorySignature[16] = "QtBinPatcherInv";
+static const uint32_t InventoryVersion       = 2;
+
+//------------------------------------------------------------------------------
+
+struct TInventory::THeader {
+    char     Signature[16];
+    uint32_t Version;
+    uint32_t DirCount;
+    uint64_t Fingerprint;
+    uint32_t SubDirCount;
+    uint32_t FileCount;
+    uint32_t StringsSize;
+    uint32_t Reserved;
+};
+
+//------------------------------------------------------------------------------
+
+struct TInventory::TDirRecord {
+    uint64_t Device;
+    uint64_t Inode;
+    uint64_t Time;
+    uint32_t Path;
+    uint32_t FirstSubDir;
+    uint32_t SubDirCount;
+    uint32_t FirstFile;
+    uint32_t FileCount;
+    uint32_t Reserved;
+};
+
+//------------------------------------------------------------------------------
+
+struct TInventory::TFileRecord {
+    uint32_t Element;
+    uint32_t Name;
+};
+
+//------------------------------------------------------------------------------
+// Size of table of subdirectories is aligned to 8 bytes.
+
+static inline size_t subDirsSize(size_t count)
+{
+    return (count * sizeof(uint32_t) + 7) & ~static_cast<size_t>(7);
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t addString(string* pStrings, const string& str)
+{
+    const uint32_t Offset = static_cast<uint32_t>(pStrings->size());
+    pStrings->append(str.c_str(), str.length() + 1);
+    return Offset;
+}
+
+//------------------------------------------------------------------------------
+
+static bool isPathLess(const TFileFinder::TDir* pDir1, const TFileFinder::TDir* pDir2)
+{
+    return pDir1->Path < pDir2->Path;
+}
+
+//------------------------------------------------------------------------------
+// Directories saved into inventory, sorted by path. Fresh directories and
+// directories without time are skipped.
+
+static void selectDirs(const string& root, const TFileFinder::TDirs& dirs, vector<const TFileFinder::TDir*>* pDirs)
+{
+    for (TFileFinder::TDirs::const_iterator Iter = dirs.begin(); Iter != dirs.end(); ++Iter)
+        if (Iter->Time != 0 && !Functions::isFreshTime(Iter->Time) && Iter->Path.length() >= root.length())
+            pDirs->push_back(&*Iter);
+    sort(pDirs->begin(), pDirs->end(), isPathLess);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TInventory::TInventory(const string& fileName, uint64_t fingerprint)
+    : m_FileName(fileName),
+      m_Fingerprint(fingerprint),
+      m_pHeader(NULL),
+      m_pDirs(NULL),
+      m_pSubDirs(NULL),
+      m_pFiles(NULL),
+      m_pStrings(NULL)
+{
+}
+
+//------------------------------------------------------------------------------
+// Strings pool ends with zero, so bad offsets give empty strings.
+
+const char* TInventory::str(uint32_t offset) const
+{
+    return offset < m_pHeader->StringsSize ? m_pStrings + offset : "";
+}
+
+//------------------------------------------------------------------------------
+// Checking that tables of subdirectories and files of directory are inside of
+// inventory.
+
+bool TInventory::isValid(const TDirRecord& dir) const
+{
+    return dir.FirstSubDir <= m_pHeader->SubDirCount && m_pHeader->SubDirCount - dir.FirstSubDir >= dir.SubDirCount &&
+           dir.FirstFile <= m_pHeader->FileCount && m_pHeader->FileCount - dir.FirstFile >= dir.FileCount;
+}
+
+//------------------------------------------------------------------------------
+// Loading inventory. Returns false if there is no inventory or it was saved
+// for other search.
+
+bool TInventory::load()
+{
+    close();
+
+    uint64_t Size = 0, Time = 0;
+    if (!Functions::getFileInfo(m_FileName, &Size, &Time) || !m_File.open(m_FileName))
+        return false;
+
+    const char* const pData = m_File.data();
+    const THeader* const pHeader = reinterpret_cast<const THeader*>(pData);
+    bool Result = m_File.size() >= sizeof(THeader) &&
+                  memcmp(pHeader->Signature, InventorySignature, sizeof(InventorySignature)) == 0 &&
+                  pHeader->Version == InventoryVersion;
+    if (Result) {
+        const size_t ExpectedSize = sizeof(THeader) +
+                                    pHeader->DirCount * sizeof(TDirRecord) +
+                                    subDirsSize(pHeader->SubDirCount) +
+                                    pHeader->FileCount * sizeof(TFileRecord) +
+                                    pHeader->StringsSize;
+        Result = m_File.size() == ExpectedSize &&
+                 pHeader->StringsSize > 0 && pData[ExpectedSize - 1] == '\0';
+    }
+    if (!Result) {
+        LOG_V("Inventory \"%s\" is broken.\n", m_FileName.c_str());
+        close();
+        return false;
+    }
+    if (pHeader->Fingerprint != m_Fingerprint) {
+        LOG_V("Inventory \"%s\" is saved for other files.\n", m_FileName.c_str());
+        close();
+        return false;
+    }
+
+    m_pHeader  = pHeader;
+    m_pDirs    = reinterpret_cast<const TDirRecord*>(pData + sizeof(THeader));
+    m_pSubDirs = reinterpret_cast<const uint32_t*>(m_pDirs + pHeader->DirCount);
+    m_pFiles   = reinterpret_cast<const TFileRecord*>(reinterpret_cast<const char*>(m_pSubDirs) +
+                                                      subDirsSize(pHeader->SubDirCount));
+    m_pStrings = reinterpret_cast<const char*>(m_pFiles + pHeader->FileCount);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void TInventory::close()
+{
+    m_File.close();
+    m_pHeader = NULL;
+}
+
+//------------------------------------------------------------------------------
+// Searching for directory by path relative to root. Identifier and time of
+// directory must be set, and they must be the same as in inventory.
+
+bool TInventory::find(const string& path, TFileFinder::TDir* pDir) const
+{
+    if (m_pHeader == NULL || pDir->Time == 0)
+        return false;
+
+    size_t Low = 0, High = m_pHeader->DirCount;
+    while (Low < High) {
+        const size_t Middle = Low + (High - Low) / 2;
+        const int Cmp = strcmp(path.c_str(), str(m_pDirs[Middle].Path));
+        if (Cmp == 0) {
+            const TDirRecord& Dir = m_pDirs[Middle];
+            if (Dir.Device != pDir->Id.first || Dir.Inode != pDir->Id.second || Dir.Time != pDir->Time ||
+                !isValid(Dir))
+                return false;
+
+            pDir->SubDirs.clear();
+            for (uint32_t i = 0; i < Dir.SubDirCount; ++i)
+                pDir->SubDirs.push_back(str(m_pSubDirs[Dir.FirstSubDir + i]));
+            pDir->Files.clear();
+            for (uint32_t i = 0; i < Dir.FileCount; ++i) {
+                const TFileRecord& File = m_pFiles[Dir.FirstFile + i];
+                pDir->Files.push_back(make_pair(static_cast<size_t>(File.Element), string(str(File.Name))));
+            }
+            return true;
+        }
+        if (Cmp < 0)
+            High = Middle;
+        else
+            Low = Middle + 1;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Checking that loaded inventory already has directories of walk from root
+// with the same times, subdirectories and files. Time of directory of the
+// inventory is not compared: saving of inventory changes it, so that
+// directory would be saved again on every walk.
+
+bool TInventory::isSaved(const string& root, const TFileFinder::TDirs& dirs) const
+{
+    if (m_pHeader == NULL)
+        return false;
+
+    vector<const TFileFinder::TDir*> Dirs;
+    selectDirs(root, dirs, &Dirs);
+    if (Dirs.size() != m_pHeader->DirCount)
+        return false;
+
+    const string FileName = Functions::normalizeSeparators(m_FileName);
+    const string InventoryDir = FileName.substr(0, FileName.rfind('/') + 1);
+
+    for (size_t i = 0; i < Dirs.size(); ++i) {
+        const TFileFinder::TDir& Dir = *Dirs[i];
+        const TDirRecord& Record = m_pDirs[i];
+        if (Dir.Path.compare(root.length(), string::npos, str(Record.Path)) != 0 ||
+            Record.Device != Dir.Id.first || Record.Inode != Dir.Id.second ||
+            (Record.Time != Dir.Time && Dir.Path != InventoryDir) ||
+            Record.SubDirCount != Dir.SubDirs.size() || Record.FileCount != Dir.Files.size() ||
+            !isValid(Record))
+            return false;
+        for (uint32_t j = 0; j < Record.SubDirCount; ++j)
+            if (Dir.SubDirs[j] != str(m_pSubDirs[Record.FirstSubDir + j]))
+                return false;
+        for (uint32_t j = 0; j < Record.FileCount; ++j) {
+            const TFileRecord& File = m_pFiles[Record.FirstFile + j];
+            if (Dir.Files[j].first != File.Element || Dir.Files[j].second != str(File.Name))
+                return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Saving directories of walk from root. Inventory is only an optimization:
+// if it can't be saved, the next search reads all directories.
+
+bool TInventory::save(const string& root, const TFileFinder::TDirs& dirs) const
+{
+    vector<const TFileFinder::TDir*> Dirs;
+    selectDirs(root, dirs, &Dirs);
+
+    vector<TDirRecord>  DirRecords;
+    vector<uint32_t>    SubDirs;
+    vector<TFileRecord> Files;
+    string Strings;
+    for (size_t i = 0; i < Dirs.size(); ++i) {
+        const TFileFinder::TDir& Dir = *Dirs[i];
+        TDirRecord Record;
+        memset(&Record, 0, sizeof(Record));
+        Record.Device      = Dir.Id.first;
+        Record.Inode       = Dir.Id.second;
+        Record.Time        = Dir.Time;
+        Record.Path        = addString(&Strings, Dir.Path.substr(root.length()));
+        Record.FirstSubDir = static_cast<uint32_t>(SubDirs.size());
+        Record.SubDirCount = static_cast<uint32_t>(Dir.SubDirs.size());
+        Record.FirstFile   = static_cast<uint32_t>(Files.size());
+        Record.FileCount   = static_cast<uint32_t>(Dir.Files.size());
+        DirRecords.push_back(Record);
+
+        for (size_t j = 0; j < Dir.SubDirs.size(); ++j)
+            SubDirs.push_back(addString(&Strings, Dir.SubDirs[j]));
+        for (size_t j = 0; j < Dir.Files.size(); ++j) {
+            TFileRecord File;
+            File.Element = static_cast<uint32_t>(Dir.Files[j].first);
+            File.Name = addString(&Strings, Dir.Files[j].second);
+            Files.push_back(File);
+        }
+    }
+    if (Strings.empty())
+        Strings += '\0';
+
+    THeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Signature, InventorySignature, sizeof(InventorySignature));
+    Header.Version     = InventoryVersion;
+    Header.DirCount    = static_cast<uint32_t>(DirRecords.size());
+    Header.Fingerprint = m_Fingerprint;
+    Header.SubDirCount = static_cast<uint32_t>(SubDirs.size());
+    Header.FileCount   = static_cast<uint32_t>(Files.size());
+    Header.StringsSize = static_cast<uint32_t>(Strings.size());
+
+    vector<char> Data(sizeof(THeader) +
+                      DirRecords.size() * sizeof(TDirRecord) +
+                      subDirsSize(SubDirs.size()) +
+                      Files.size() * sizeof(TFileRecord) +
+                      Strings.size());
+    char* p = Data.data();
+    memcpy(p, &Header, sizeof(Header));
+    p += sizeof(Header);
+    if (!DirRecords.empty())
+        memcpy(p, DirRecords.data(), DirRecords.size() * sizeof(TDirRecord));
+    p += DirRecords.size() * sizeof(TDirRecord);
+    if (!SubDirs.empty())
+        memcpy(p, SubDirs.data(), SubDirs.size() * sizeof(uint32_t));
+    p += subDirsSize(SubDirs.size());
+    if (!Files.empty())
+        memcpy(p, Files.data(), Files.size() * sizeof(TFileRecord));
+    p += Files.size() * sizeof(TFileRecord);
+    memcpy(p, Strings.data(), Strings.size());
+
+    const bool Result = Functions::writeFileAtomic(m_FileName, Data.data(), Data.size(), true);
+    if (Result)
+        LOG_V("Inventory \"%s\" is saved (%u directories).\n", m_FileName.c_str(), Header.DirCount);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
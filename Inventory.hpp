@@ -0,0 +1,83 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_INVENTORY__
+#define __QTBINPATCHER2_INVENTORY__
+
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+#include "FileFinder.hpp"
+#include "MappedFile.hpp"
+
+//------------------------------------------------------------------------------
+// Inventory of directory tree walked by TFileFinder. For every directory it
+// keeps path relative to the root of walk, device, inode and modification
+// time, needed subdirectories and found files. Inventory file is mapped into
+// memory and used as is: it consists of header, table of directories sorted
+// by path, tables of subdirectories and files and pool of strings.
+
+class TInventory
+{
+    private :
+        struct THeader;
+        struct TDirRecord;
+        struct TFileRecord;
+
+        std::string        m_FileName;
+        uint64_t           m_Fingerprint;
+        TMappedFile        m_File;
+        const THeader*     m_pHeader;
+        const TDirRecord*  m_pDirs;
+        const uint32_t*    m_pSubDirs;
+        const TFileRecord* m_pFiles;
+        const char*        m_pStrings;
+
+        TInventory(const TInventory&);
+        TInventory& operator=(const TInventory&);
+
+        const char* str(uint32_t offset) const;
+        bool isValid(const TDirRecord& dir) const;
+
+    public :
+        TInventory(const std::string& fileName, uint64_t fingerprint);
+
+        bool load();
+        void close();
+        bool find(const std::string& path, TFileFinder::TDir* pDir) const;
+        bool isSaved(const std::string& root, const TFileFinder::TDirs& dirs) const;
+        bool save(const std::string& root, const TFileFinder::TDirs& dirs) const;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_INVENTORY__
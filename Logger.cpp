@@ -36,8 +36,23 @@
 
 //------------------------------------------------------------------------------
 
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
+
+//------------------------------------------------------------------------------
+
 bool TLogger::m_Verbose = false;
 
+// Buffer of current thread. If it's NULL, messages are printed immediately.
+static THREAD_LOCAL TLogger::TBuffer* pThreadBuffer = NULL;
+
 //------------------------------------------------------------------------------
 
 TLogger::TLogger()
@@ -55,8 +70,37 @@ TLogger::~TLogger()
 
 //------------------------------------------------------------------------------
 
+static string formatMessage(const char* const format, va_list vaList)
+{
+    va_list vaList2;
+    va_copy(vaList2, vaList);
+    #ifdef _MSC_VER
+        const int Length = _vscprintf(format, vaList2);
+    #else
+        const int Length = vsnprintf(NULL, 0, format, vaList2);
+    #endif
+    va_end(vaList2);
+    if (Length <= 0)
+        return string();
+
+    vector<char> Buf(static_cast<size_t>(Length) + 1);
+    vsnprintf(Buf.data(), Buf.size(), format, vaList);
+    return string(Buf.data(), static_cast<size_t>(Length));
+}
+
+//------------------------------------------------------------------------------
+
 void TLogger::printf(FILE* stdstream, const char* const format, va_list vaList)
 {
+    if (pThreadBuffer != NULL) {
+        TMessage Message;
+        Message.IsError = stdstream == stderr;
+        Message.Text = formatMessage(format, vaList);
+        pThreadBuffer->push_back(Message);
+        return;
+    }
+
+    TMutexLocker Locker(m_Mutex);
     if (m_pFile != NULL) {
         va_list vaList2;
         va_copy(vaList2, vaList);
@@ -117,3 +161,29 @@ void TLogger::printf_err(const char* const format, ...)
 }
 
 //------------------------------------------------------------------------------
+// Printing of messages collected by thread. Buffer is cleared.
+
+void TLogger::flush(TBuffer* pBuffer)
+{
+    TMutexLocker Locker(m_Mutex);
+    for (TBuffer::const_iterator Iter = pBuffer->begin(); Iter != pBuffer->end(); ++Iter) {
+        FILE* const StdStream = Iter->IsError ? stderr : stdout;
+        if (m_pFile != NULL) {
+            fputs(Iter->Text.c_str(), m_pFile);
+            fflush(m_pFile);
+        }
+        fputs(Iter->Text.c_str(), StdStream);
+        fflush(StdStream);
+    }
+    pBuffer->clear();
+}
+
+//------------------------------------------------------------------------------
+// Setting buffer for messages of current thread (NULL to print immediately).
+
+void TLogger::setBuffer(TBuffer* pBuffer)
+{
+    pThreadBuffer = pBuffer;
+}
+
+//------------------------------------------------------------------------------
@@ -36,14 +36,28 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string>
+#include <vector>
+
+#include "Threads.hpp"
 
 //------------------------------------------------------------------------------
+// Messages may be written from several threads. Thread can collect its
+// messages in buffer and print them later at once (see setBuffer()).
 
 class TLogger
 {
+    public :
+        struct TMessage {
+            bool        IsError;
+            std::string Text;
+        };
+        typedef std::vector<TMessage> TBuffer;
+
     private :
         static bool m_Verbose;
         FILE* m_pFile;
+        TMutex m_Mutex;
 
         TLogger();
         ~TLogger();
@@ -55,6 +69,9 @@ class TLogger
         void setFileName(const char *const fileName);
         void printf(const char *const format, ...);
         void printf_err(const char *const format, ...);
+        void flush(TBuffer* pBuffer);
+
+        static void setBuffer(TBuffer* pBuffer);
 
         static inline bool verbose() { return m_Verbose; }
         static inline void setVerbose(bool verbose) { m_Verbose = verbose; }
@@ -0,0 +1,161 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "MappedFile.hpp"
+
+#include <errno.h>
+#if defined(OS_WINDOWS)
+    #include <windows.h>
+#elif defined(OS_LINUX)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "Logger.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TMappedFile::TMappedFile()
+    : m_pData(NULL),
+      m_Size(0),
+    #if defined(OS_WINDOWS)
+      m_hFile(INVALID_HANDLE_VALUE),
+      m_hMapping(NULL)
+    #else
+      m_Fd(-1)
+    #endif
+{
+}
+
+//------------------------------------------------------------------------------
+
+TMappedFile::~TMappedFile()
+{
+    close();
+}
+
+//------------------------------------------------------------------------------
+
+bool TMappedFile::open(const string& fileName)
+{
+    close();
+    m_FileName = fileName;
+
+    #if defined(OS_WINDOWS)
+        m_hFile = CreateFileA(fileName.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (m_hFile == INVALID_HANDLE_VALUE) {
+            LOG_E("Error opening file \"%s\". Error %lu.\n", fileName.c_str(), GetLastError());
+            return false;
+        }
+        LARGE_INTEGER Size;
+        if (!GetFileSizeEx(m_hFile, &Size)) {
+            LOG_E("Error getting size of file \"%s\". Error %lu.\n", fileName.c_str(), GetLastError());
+            close();
+            return false;
+        }
+        m_Size = static_cast<size_t>(Size.QuadPart);
+        if (m_Size > 0) {
+            m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (m_hMapping != NULL)
+                m_pData = static_cast<char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+            if (m_pData == NULL) {
+                LOG_E("Error mapping file \"%s\". Error %lu.\n", fileName.c_str(), GetLastError());
+                close();
+                return false;
+            }
+        }
+    #elif defined(OS_LINUX)
+        m_Fd = ::open(fileName.c_str(), O_RDONLY);
+        if (m_Fd == -1) {
+            LOG_E("Error opening file \"%s\". Error %i.\n", fileName.c_str(), errno);
+            return false;
+        }
+        struct stat Stat;
+        if (fstat(m_Fd, &Stat) != 0) {
+            LOG_E("Error getting size of file \"%s\". Error %i.\n", fileName.c_str(), errno);
+            close();
+            return false;
+        }
+        m_Size = static_cast<size_t>(Stat.st_size);
+        if (m_Size > 0) {
+            void* pData = mmap(NULL, m_Size, PROT_READ, MAP_SHARED, m_Fd, 0);
+            if (pData == MAP_FAILED) {
+                LOG_E("Error mapping file \"%s\". Error %i.\n", fileName.c_str(), errno);
+                close();
+                return false;
+            }
+            m_pData = static_cast<char*>(pData);
+            madvise(pData, m_Size, MADV_SEQUENTIAL);
+        }
+    #else
+        #error "Unsupported OS."
+    #endif
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void TMappedFile::close()
+{
+    #if defined(OS_WINDOWS)
+        if (m_pData != NULL)
+            UnmapViewOfFile(m_pData);
+        if (m_hMapping != NULL)
+            CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE)
+            CloseHandle(m_hFile);
+        m_hMapping = NULL;
+        m_hFile = INVALID_HANDLE_VALUE;
+    #elif defined(OS_LINUX)
+        if (m_pData != NULL)
+            munmap(m_pData, m_Size);
+        if (m_Fd != -1)
+            ::close(m_Fd);
+        m_Fd = -1;
+    #else
+        #error "Unsupported OS."
+    #endif
+    m_pData = NULL;
+    m_Size = 0;
+}
+
+//------------------------------------------------------------------------------
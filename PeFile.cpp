@@ -0,0 +1,189 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "PeFile.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const unsigned char PeMagic[] = { 'P', 'E', 0, 0 };
+
+static const uint64_t DOS_HEADER_SIZE                  = 0x40;
+static const uint64_t COFF_HEADER_SIZE                 = 20;
+static const uint64_t SECTION_HEADER_SIZE              = 40;
+static const uint64_t SYMBOL_SIZE                      = 18;
+static const uint32_t IMAGE_SCN_CNT_UNINITIALIZED_DATA = 0x00000080;
+
+//------------------------------------------------------------------------------
+// Sections, which can contain "qt_????path=" slots.
+
+static const char* const DataSections[] = {
+    ".rdata",
+    ".data"
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TPeFile::TPeFile(const char* data, size_t size)
+    : m_pData(reinterpret_cast<const unsigned char*>(data)),
+      m_Size(size)
+{
+    if (isPe(data, size))
+        if (!readSections())
+            m_Sections.clear();
+}
+
+//------------------------------------------------------------------------------
+
+bool TPeFile::isPe(const char* data, size_t size)
+{
+    const unsigned char* const Data = reinterpret_cast<const unsigned char*>(data);
+    if (size < DOS_HEADER_SIZE || Data[0] != 'M' || Data[1] != 'Z')
+        return false;
+    const uint32_t PeOffset = Data[0x3C] | (Data[0x3D] << 8) | (Data[0x3E] << 16) |
+                              (static_cast<uint32_t>(Data[0x3F]) << 24);
+    return PeOffset <= size && size - PeOffset >= sizeof(PeMagic) + COFF_HEADER_SIZE &&
+           memcmp(Data + PeOffset, PeMagic, sizeof(PeMagic)) == 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool TPeFile::inFile(uint64_t offset, uint64_t size) const
+{
+    return offset <= m_Size && size <= m_Size - offset;
+}
+
+//------------------------------------------------------------------------------
+// PE/COFF is always little endian.
+
+uint16_t TPeFile::read16(uint64_t offset) const
+{
+    const unsigned char* p = m_pData + offset;
+    return static_cast<uint16_t>((p[1] << 8) | p[0]);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t TPeFile::read32(uint64_t offset) const
+{
+    return (static_cast<uint32_t>(read16(offset + 2)) << 16) | read16(offset);
+}
+
+//------------------------------------------------------------------------------
+
+string TPeFile::readString(uint64_t offset, uint64_t end) const
+{
+    if (end > m_Size)
+        end = m_Size;
+    string Result;
+    for (uint64_t i = offset; i < end && m_pData[i] != '\0'; ++i)
+        Result += static_cast<char>(m_pData[i]);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+
+bool TPeFile::readSections()
+{
+    const uint64_t CoffHeader = read32(0x3C) + sizeof(PeMagic);
+    const uint64_t SectionNum = read16(CoffHeader + 2);
+    const uint64_t SymTabOff  = read32(CoffHeader + 8);
+    const uint64_t SymbolNum  = read32(CoffHeader + 12);
+    const uint64_t SectionOff = CoffHeader + COFF_HEADER_SIZE + read16(CoffHeader + 16);
+
+    if (SectionNum == 0 || !inFile(SectionOff, SectionNum * SECTION_HEADER_SIZE))
+        return false;
+
+    // Names longer than 8 characters (MinGW writes them for debug sections)
+    // are stored as "/<offset>" in COFF string table after symbol table.
+    const uint64_t StrTabOff = SymTabOff + SymbolNum * SYMBOL_SIZE;
+    const uint64_t StrTabSize = SymTabOff != 0 && inFile(StrTabOff, 4) ? read32(StrTabOff) : 0;
+
+    m_Sections.resize(static_cast<size_t>(SectionNum));
+    for (size_t i = 0; i < m_Sections.size(); ++i) {
+        const uint64_t Header = SectionOff + i * SECTION_HEADER_SIZE;
+        TSection& Section = m_Sections[i];
+        Section.Name        = readString(Header, Header + 8);
+        Section.VirtualSize = read32(Header + 8);
+        Section.RawSize     = read32(Header + 16);
+        Section.RawOffset   = read32(Header + 20);
+        Section.Flags       = read32(Header + 36);
+
+        if (Section.Name.length() > 1 && Section.Name[0] == '/') {
+            const uint64_t NameOffset = strtoul(Section.Name.c_str() + 1, NULL, 10);
+            if (NameOffset < StrTabSize)
+                Section.Name = readString(StrTabOff + NameOffset, StrTabOff + StrTabSize);
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Getting file ranges of data sections (".rdata", ".data" and their grouped
+// parts like ".data$r"). Returns false if there is no section table; the
+// whole file must be scanned in this case.
+
+bool TPeFile::getDataRanges(TFileRanges* pRanges) const
+{
+    if (m_Sections.empty())
+        return false;
+
+    for (TSections::const_iterator Iter = m_Sections.begin(); Iter != m_Sections.end(); ++Iter)
+    {
+        // Raw size is aligned to FileAlignment, tail after virtual size is padding.
+        uint32_t Size = Iter->RawSize;
+        if (Iter->VirtualSize != 0 && Iter->VirtualSize < Size)
+            Size = Iter->VirtualSize;
+        if ((Iter->Flags & IMAGE_SCN_CNT_UNINITIALIZED_DATA) != 0 ||
+            Iter->RawOffset == 0 || Size == 0 || !inFile(Iter->RawOffset, Size))
+            continue;
+        for (size_t i = 0; i < sizeof(DataSections)/sizeof(DataSections[0]); ++i) {
+            const size_t Length = strlen(DataSections[i]);
+            if (Iter->Name.compare(0, Length, DataSections[i]) == 0 &&
+                (Iter->Name.length() == Length || Iter->Name[Length] == '$'))
+            {
+                pRanges->push_back(TFileRange(Iter->RawOffset, Size));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
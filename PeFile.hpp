@@ -0,0 +1,81 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_PEFILE__
+#define __QTBINPATCHER2_PEFILE__
+
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <vector>
+
+#include "CommonTypes.hpp"
+
+//------------------------------------------------------------------------------
+// Reader of PE/COFF section table (PE32 and PE32+) from file data in memory.
+// Doesn't depend on host OS, so it is tested on fixtures on any host.
+
+class TPeFile
+{
+    private :
+        struct TSection {
+            std::string Name;
+            uint32_t    VirtualSize;
+            uint32_t    RawSize;
+            uint32_t    RawOffset;
+            uint32_t    Flags;
+        };
+        typedef std::vector<TSection> TSections;
+
+        const unsigned char* m_pData;
+        size_t               m_Size;
+        TSections            m_Sections;
+
+        bool inFile(uint64_t offset, uint64_t size) const;
+        uint16_t read16(uint64_t offset) const;
+        uint32_t read32(uint64_t offset) const;
+        std::string readString(uint64_t offset, uint64_t end) const;
+        bool readSections();
+
+    public :
+        TPeFile(const char* data, size_t size);
+
+        static bool isPe(const char* data, size_t size);
+
+        bool getDataRanges(TFileRanges* pRanges) const;
+
+        inline bool hasSections() const
+            { return !m_Sections.empty(); }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_PEFILE__
@@ -31,8 +31,10 @@
 
 #include "QMake.hpp"
 
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <vector>
 
 #include "Functions.hpp"
 #include "Logger.hpp"
@@ -56,6 +58,22 @@ const string TQMake::m_BinDirName("bin");
 
 //------------------------------------------------------------------------------
 
+static const char CacheSignature[]   = "QtBinPatcher qmake cache 1";
+static const char CacheFileSuffix[]  = ".qtbpquery";
+static const char CacheValueTag[]    = "value ";
+static const char CacheSuffixTag[]   = "suffix ";
+
+//------------------------------------------------------------------------------
+
+static void logMap(const char* title, const TStringMap& map)
+{
+    LOG_V("\n%s:\n", title);
+    for (TStringMap::const_iterator Iter = map.begin(); Iter != map.end(); ++Iter)
+        LOG_V("  %s = \"%s\"\n", Iter->first.c_str(), Iter->second.c_str());
+}
+
+//------------------------------------------------------------------------------
+
 bool TQMake::find(const string& qtDir)
 {
     m_QMakePath = (qtDir.empty() ? currentDir() : qtDir) + separator();
@@ -73,6 +91,133 @@ bool TQMake::find(const string& qtDir)
     return !m_QMakePath.empty();
 }
 
+//------------------------------------------------------------------------------
+// Output of qmake is cached next to it (in "<qmake>.qtbpquery").
+
+string TQMake::cacheFileName() const
+{
+    return m_QMakePath + m_QMakeName + CacheFileSuffix;
+}
+
+//------------------------------------------------------------------------------
+// Key of cache: path, size, modification time and inode of qmake and hash of
+// qt.conf near it (zero if there is no qt.conf). Empty key means that qmake
+// output can't be cached.
+
+string TQMake::cacheKey() const
+{
+    const string QMakeFileName = m_QMakePath + m_QMakeName;
+    uint64_t Size = 0, Time = 0, Inode = 0;
+    if (!getFileInfo(QMakeFileName, &Size, &Time, &Inode))
+        return string();
+
+    const string QtConfFileName = m_QMakePath + "qt.conf";
+    uint64_t QtConfSize = 0, QtConfTime = 0, QtConfHash = 0;
+    if (getFileInfo(QtConfFileName, &QtConfSize, &QtConfTime)) {
+        vector<char> QtConf;
+        if (!readFile(QtConfFileName, &QtConf))
+            return string();
+        QtConfHash = Functions::hash(QtConf.data(), QtConf.size());
+    }
+
+    char Buffer[160];
+    sprintf(Buffer, "size %llu time %llu inode %llu path %016llx conf %016llx",
+            static_cast<unsigned long long>(Size),
+            static_cast<unsigned long long>(Time),
+            static_cast<unsigned long long>(Inode),
+            static_cast<unsigned long long>(Functions::hash(QMakeFileName.data(), QMakeFileName.length())),
+            static_cast<unsigned long long>(QtConfHash));
+    return Buffer;
+}
+
+//------------------------------------------------------------------------------
+// Loading parsed qmake variables and Qt subdirs from cache. Returns false if
+// there is no cache or it was saved for other qmake or qt.conf.
+
+bool TQMake::loadCache(const string& key)
+{
+    const string FileName = cacheFileName();
+    if (key.empty() || !isFileExists(FileName))
+        return false;
+
+    vector<char> Buf;
+    if (!readFile(FileName, &Buf))
+        return false;
+    const string Data(Buf.begin(), Buf.end());
+
+    TStringMap Values, Suffixes;
+    bool Result = !Data.empty() && Data[Data.length() - 1] == '\n';
+    string::size_type Begin = 0;
+    for (size_t i = 0; Result && Begin < Data.length(); ++i) {
+        const string::size_type End = Data.find('\n', Begin);
+        const string Line = Data.substr(Begin, End - Begin);
+        Begin = End + 1;
+
+        if (i == 0) {
+            Result = Line == CacheSignature;
+        }
+        else if (i == 1) {
+            if (Line != key) {
+                LOG_V("qmake cache \"%s\" is outdated.\n", FileName.c_str());
+                return false;
+            }
+        }
+        else {
+            TStringMap* pMap = NULL;
+            string::size_type Start = 0;
+            if (startsWith(Line, CacheValueTag)) {
+                pMap = &Values;
+                Start = sizeof(CacheValueTag) - 1;
+            }
+            else if (startsWith(Line, CacheSuffixTag)) {
+                pMap = &Suffixes;
+                Start = sizeof(CacheSuffixTag) - 1;
+            }
+            const string::size_type Colon = Line.find(':', Start);
+            Result = pMap != NULL && Colon != string::npos;
+            if (Result)
+                (*pMap)[Line.substr(Start, Colon - Start)] = Line.substr(Colon + 1);
+        }
+    }
+    if (!Result || Values.empty()) {
+        LOG_V("qmake cache \"%s\" is broken.\n", FileName.c_str());
+        return false;
+    }
+
+    LOG_V("qmake output is taken from cache \"%s\".\n", FileName.c_str());
+    m_QMakeValues.swap(Values);
+    m_Suffixes.swap(Suffixes);
+    parseVersion();
+
+    logMap("Parsed qmake variables", m_QMakeValues);
+    logMap("Parsed Qt subdirs", m_Suffixes);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Saving parsed qmake variables and Qt subdirs. Cache is only an
+// optimization: if it can't be saved, the next run starts qmake again.
+
+void TQMake::saveCache(const string& key) const
+{
+    uint64_t Size = 0, Time = 0;
+    if (key.empty() ||
+        !getFileInfo(m_QMakePath + m_QMakeName, &Size, &Time))
+        return;
+    if (isFreshTime(Time))
+        return;
+
+    string Data = string(CacheSignature) + "\n" + key + "\n";
+    for (TStringMap::const_iterator Iter = m_QMakeValues.begin(); Iter != m_QMakeValues.end(); ++Iter)
+        Data += CacheValueTag + Iter->first + ":" + Iter->second + "\n";
+    for (TStringMap::const_iterator Iter = m_Suffixes.begin(); Iter != m_Suffixes.end(); ++Iter)
+        Data += CacheSuffixTag + Iter->first + ":" + Iter->second + "\n";
+
+    const string FileName = cacheFileName();
+    if (writeFileAtomic(FileName, Data.data(), Data.length()))
+        LOG_V("qmake cache \"%s\" is saved.\n", FileName.c_str());
+}
+
 //------------------------------------------------------------------------------
 
 bool TQMake::query()
@@ -98,6 +243,18 @@ bool TQMake::query()
 
 //------------------------------------------------------------------------------
 
+void TQMake::parseVersion()
+{
+    TStringMap::const_iterator Iter = m_QMakeValues.find("QT_VERSION");
+    if (Iter != m_QMakeValues.end()) {
+        const string& Version = Iter->second;
+        if (!Version.empty())
+            m_QtVersion = Version[0];
+    }
+}
+
+//------------------------------------------------------------------------------
+
 bool TQMake::parseValues()
 {
     const char* const Delimiters = "\r\n";
@@ -116,16 +273,9 @@ bool TQMake::parseValues()
         s = strtok(NULL, Delimiters);
     }
 
-    TStringMap::const_iterator Iter = m_QMakeValues.find("QT_VERSION");
-    if (Iter != m_QMakeValues.end()) {
-        const string& Version = Iter->second;
-        if (!Version.empty())
-            m_QtVersion = Version[0];
-    }
+    parseVersion();
 
-    LOG_V("\nParsed qmake variables:\n");
-    for (Iter = m_QMakeValues.begin(); Iter != m_QMakeValues.end(); ++Iter)
-        LOG_V("  %s = \"%s\"\n", Iter->first.c_str(), Iter->second.c_str());
+    logMap("Parsed qmake variables", m_QMakeValues);
 
     return true;
 }
@@ -189,9 +339,7 @@ bool TQMake::parseSuffixes()
         }
     }
 
-    LOG_V("\nParsed Qt subdirs:\n");
-    for (TStringMap::iterator Iter = m_Suffixes.begin(); Iter != m_Suffixes.end(); ++Iter)
-        LOG_V("  %s = \"%s\"\n", Iter->first.c_str(), Iter->second.c_str());
+    logMap("Parsed Qt subdirs", m_Suffixes);
 
     return true;
 }
@@ -247,9 +395,18 @@ TQMake::TQMake(const string& qtDir)
     : m_QtVersion('\0')
 {
     if (find(qtDir)) {
-        TBackup Backup;
-        Backup.backupFile(m_QMakePath + "qt.conf", TBackup::bmRename);
-        query() && parse() && getQtPath();
+        // Key is taken before qt.conf is renamed.
+        const string Key = cacheKey();
+        bool Result = loadCache(Key);
+        if (!Result) {
+            TBackup Backup;
+            Backup.backupFile(m_QMakePath + "qt.conf", TBackup::bmRename);
+            Result = query() && parse();
+            if (Result)
+                saveCache(Key);
+        }
+        if (Result)
+            getQtPath();
     }
 }
 
@@ -53,7 +53,12 @@ class TQMake
         char        m_QtVersion;
 
         bool find(const std::string& qtDir);
+        std::string cacheFileName() const;
+        std::string cacheKey() const;
+        bool loadCache(const std::string& key);
+        void saveCache(const std::string& key) const;
         bool query();
+        void parseVersion();
         bool parseValues();
         bool addSuffix(const TStringMap::const_iterator& Iter,
                        const std::string& prefix,
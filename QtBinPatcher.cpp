@@ -32,9 +32,11 @@
 #include "QtBinPatcher.hpp"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <ctype.h>
 #include <vector>
 #include <algorithm>
 
@@ -45,6 +47,13 @@
 #include "CmdLineChecker.hpp"
 #include "QMake.hpp"
 #include "Backup.hpp"
+#include "BackupArchive.hpp"
+#include "MappedFile.hpp"
+#include "ElfFile.hpp"
+#include "PeFile.hpp"
+#include "Threads.hpp"
+#include "FileFinder.hpp"
+#include "ShadowTree.hpp"
 
 //------------------------------------------------------------------------------
 
@@ -54,20 +63,10 @@ using namespace Functions;
 //------------------------------------------------------------------------------
 
 #define QT_PATH_MAX_LEN 450
+#define MAX_JOBS        256
 
 //------------------------------------------------------------------------------
 
-#ifdef OS_WINDOWS
-// Case-insensitive comparision (only for case-independent file systems).
-
-bool caseInsensitiveComp(const char c1, const char c2)
-{
-    return tolower(c1) == tolower(c2);
-}
-
-#endif
-
-//------------------------------------------------------------------------------
 // String comparision. For OS Windows comparision is case-insensitive.
 
 bool strneq(const string& s1, const string& s2)
@@ -82,6 +81,136 @@ bool strneq(const string& s1, const string& s2)
     #endif
 }
 
+//------------------------------------------------------------------------------
+// Job of patching of files from list in several threads. Files are patched
+// from the largest to the smallest, so the largest files don't finish last.
+// Messages of each file are collected and printed in order of the list as
+// soon as all previous files are done, so log doesn't depend on threads.
+
+class TPatchJob : public TThreadPool::TJob
+{
+    public :
+        typedef bool (TQtBinPatcher::*TPatchFunc)(const string&);
+
+    private :
+        TQtBinPatcher*           m_pPatcher;
+        TPatchFunc               m_PatchFunc;
+        vector<string>           m_Files;
+        vector<size_t>           m_Order;
+        vector<TLogger::TBuffer> m_Logs;
+        vector<bool>             m_Done;
+        size_t                   m_NextLog;
+        TMutex                   m_Mutex;
+
+    public :
+        TPatchJob(TQtBinPatcher* pPatcher, TPatchFunc patchFunc, const TStringList& files);
+        virtual bool run(size_t index);
+        void flushLogs();
+};
+
+//------------------------------------------------------------------------------
+
+TPatchJob::TPatchJob(TQtBinPatcher* pPatcher, TPatchFunc patchFunc, const TStringList& files)
+    : m_pPatcher(pPatcher),
+      m_PatchFunc(patchFunc),
+      m_Files(files.begin(), files.end()),
+      m_Logs(m_Files.size()),
+      m_Done(m_Files.size(), false),
+      m_NextLog(0)
+{
+    // Inverted size: the largest files first, equal sizes in list order.
+    vector< pair<uint64_t, size_t> > Sizes;
+    for (size_t i = 0; i < m_Files.size(); ++i) {
+        uint64_t Size = 0, Time = 0;
+        getFileInfo(m_Files[i], &Size, &Time);
+        Sizes.push_back(make_pair(~Size, i));
+    }
+    sort(Sizes.begin(), Sizes.end());
+    for (size_t i = 0; i < Sizes.size(); ++i)
+        m_Order.push_back(Sizes[i].second);
+}
+
+//------------------------------------------------------------------------------
+
+bool TPatchJob::run(size_t index)
+{
+    const size_t File = m_Order[index];
+    TLogger::setBuffer(&m_Logs[File]);
+    const bool Result = (m_pPatcher->*m_PatchFunc)(m_Files[File]);
+    TLogger::setBuffer(NULL);
+
+    TMutexLocker Locker(m_Mutex);
+    m_Done[File] = true;
+    for (; m_NextLog < m_Files.size() && m_Done[m_NextLog]; ++m_NextLog)
+        TLogger::instance()->flush(&m_Logs[m_NextLog]);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Printing messages of files, which were done after failed one (files after
+// failure are not patched at all).
+
+void TPatchJob::flushLogs()
+{
+    TMutexLocker Locker(m_Mutex);
+    for (; m_NextLog < m_Files.size(); ++m_NextLog)
+        if (m_Done[m_NextLog])
+            TLogger::instance()->flush(&m_Logs[m_NextLog]);
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// Job of checking files before backup. Checks don't fail, they only mark
+// files as needed. Their messages are collected and dropped: errors of
+// needed files are reported by patching.
+
+class TFilterJob : public TThreadPool::TJob
+{
+    public :
+        typedef bool (TQtBinPatcher::*TFilterFunc)(const string&) const;
+
+    private :
+        const TQtBinPatcher* m_pPatcher;
+        TFilterFunc          m_FilterFunc;
+        vector<string>       m_Files;
+        vector<char>         m_Needed;
+
+    public :
+        TFilterJob(const TQtBinPatcher* pPatcher, TFilterFunc filterFunc, const TStringList& files);
+        virtual bool run(size_t index);
+        void getFiles(TStringList* pNeeded, TStringList* pSkipped) const;
+};
+
+//------------------------------------------------------------------------------
+
+TFilterJob::TFilterJob(const TQtBinPatcher* pPatcher, TFilterFunc filterFunc, const TStringList& files)
+    : m_pPatcher(pPatcher),
+      m_FilterFunc(filterFunc),
+      m_Files(files.begin(), files.end()),
+      m_Needed(m_Files.size(), 0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+bool TFilterJob::run(size_t index)
+{
+    TLogger::TBuffer Log;
+    TLogger::setBuffer(&Log);
+    m_Needed[index] = (m_pPatcher->*m_FilterFunc)(m_Files[index]) ? 1 : 0;
+    TLogger::setBuffer(NULL);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void TFilterJob::getFiles(TStringList* pNeeded, TStringList* pSkipped) const
+{
+    pNeeded->clear();
+    for (size_t i = 0; i < m_Files.size(); ++i)
+        (m_Needed[i] != 0 ? pNeeded : pSkipped)->push_back(m_Files[i]);
+}
+
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
 
@@ -131,6 +260,56 @@ bool TQtBinPatcher::getNewQtDir()
 
 //------------------------------------------------------------------------------
 
+bool TQtBinPatcher::getJobs()
+{
+    m_Jobs = 1;
+    if (!m_ArgsMap.contains(OPT_JOBS))
+        return true;
+
+    const string Value = m_ArgsMap.value(OPT_JOBS);
+    char* pEnd = NULL;
+    const unsigned long Jobs = strtoul(Value.c_str(), &pEnd, 10);
+    if (Value.empty() || *pEnd != '\0' || Jobs > MAX_JOBS) {
+        LOG_E("Invalid number of jobs \"%s\".\n", Value.c_str());
+        return false;
+    }
+
+    m_Jobs = Jobs > 0 ? static_cast<unsigned int>(Jobs) : TThreadPool::processorCount();
+    LOG_V("Number of jobs: %u.\n", m_Jobs);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Size of memory for backup: number of bytes with optional suffix K, M or G.
+
+bool TQtBinPatcher::getBackupMemory()
+{
+    m_BackupMemory = 0;
+    if (!m_ArgsMap.contains(OPT_BACKUP_MEMORY))
+        return true;
+
+    const string Value = m_ArgsMap.value(OPT_BACKUP_MEMORY);
+    char* pEnd = NULL;
+    unsigned long long Size = strtoull(Value.c_str(), &pEnd, 10);
+    unsigned int Shift = 0;
+    switch (*pEnd) {
+        case 'K' : case 'k' : Shift = 10; ++pEnd; break;
+        case 'M' : case 'm' : Shift = 20; ++pEnd; break;
+        case 'G' : case 'g' : Shift = 30; ++pEnd; break;
+    }
+    if (Value.empty() || !isdigit(static_cast<unsigned char>(Value[0])) || *pEnd != '\0' ||
+        Size > (~0ull >> Shift))
+    {
+        LOG_E("Invalid size of memory for backup \"%s\".\n", Value.c_str());
+        return false;
+    }
+
+    m_BackupMemory = static_cast<uint64_t>(Size << Shift);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
 bool TQtBinPatcher::isPatchNeeded()
 {
     assert(hasOnlyNormalSeparators(m_NewQtDir));
@@ -141,6 +320,24 @@ bool TQtBinPatcher::isPatchNeeded()
     return false;
 }
 
+//------------------------------------------------------------------------------
+// Returns false if patching is not needed and not forced.
+
+bool TQtBinPatcher::checkPatchNeeded()
+{
+    if (isPatchNeeded())
+        return true;
+
+    if (m_ArgsMap.contains(OPT_FORCE)) {
+        LOG("\nThe new and the old pathes to Qt directory are the same.\n"
+            "Perform forced patching.\n\n");
+        return true;
+    }
+    LOG("\nThe new and the old pathes to Qt directory are the same.\n"
+        "Patching not needed.\n");
+    return false;
+}
+
 //------------------------------------------------------------------------------
 
 void TQtBinPatcher::addTxtPatchValues(const string& oldPath)
@@ -221,7 +418,7 @@ void TQtBinPatcher::createBinPatchValues()
 
 //------------------------------------------------------------------------------
 
-void TQtBinPatcher::createPatchValues()
+bool TQtBinPatcher::createPatchValues()
 {
     m_TxtPatchValues.clear();
     m_BinPatchValues.clear();
@@ -234,11 +431,32 @@ void TQtBinPatcher::createPatchValues()
         for (TStringList::const_iterator Iter = pValues->begin(); Iter != pValues->end(); ++Iter)
             addTxtPatchValues(normalizeSeparators(*Iter));
 
+    return initPatchValues();
+}
+
+//------------------------------------------------------------------------------
+// Preparing of replacer and matcher for patch values.
+
+bool TQtBinPatcher::initPatchValues()
+{
+    m_TxtReplacer.init(m_TxtPatchValues,
+                       #ifdef OS_WINDOWS
+                           true
+                       #else
+                           false
+                       #endif
+                      );
+
+    LOG_V("\nSearch kernel: %s.\n", TSearchKernel::name());
+    LOG_V("Text replace kernel: %s.\n", m_TxtReplacer.kernelName().c_str());
+
     LOG_V("\nPatch values for text files:\n%s",
           stringMapToStr(m_TxtPatchValues, "  \"", "\" -> \"", "\"\n").c_str());
 
     LOG_V("\nPatch values for binary files:\n%s",
           stringMapToStr(m_BinPatchValues, "  \"", "\" -> \"", "\"\n").c_str());
+
+    return m_BinMatcher.init(m_BinPatchValues);
 }
 
 //------------------------------------------------------------------------------
@@ -285,8 +503,6 @@ bool TQtBinPatcher::createTxtFilesForPatchList()
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    m_TxtFilesForPatch.clear();
-
     const TElement* Elements;
     size_t Count;
     switch (m_QMake.qtVersion()) {
@@ -302,12 +518,11 @@ bool TQtBinPatcher::createTxtFilesForPatchList()
             LOG_E("Unsupported Qt version (%c).", m_QMake.qtVersion());
             return false;
     }
-    for (size_t i = 0; i < Count; ++i) {
-        if (Elements[i].Recursive)
-            splice(&m_TxtFilesForPatch, findFilesRecursive(m_QtDir + Elements[i].Dir, Elements[i].Name));
-        else
-            splice(&m_TxtFilesForPatch, findFiles(m_QtDir + Elements[i].Dir, Elements[i].Name));
-    }
+    TFileFinder Finder;
+    for (size_t i = 0; i < Count; ++i)
+        Finder.add(m_QtDir + Elements[i].Dir, Elements[i].Name, Elements[i].Recursive);
+    Finder.setInventory(m_QtDir + "/.txt.qtbpinv");
+    m_TxtFilesForPatch = Finder.find(m_Jobs);
 
     LOG_V("\nList of text files for patch:\n%s\n",
           stringListToStr(m_TxtFilesForPatch, "  ", "\n").c_str());
@@ -356,8 +571,6 @@ bool TQtBinPatcher::createBinFilesForPatchList()
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    m_BinFilesForPatch.clear();
-
     const TElement* Elements;
     size_t Count;
     switch (m_QMake.qtVersion()) {
@@ -374,8 +587,11 @@ bool TQtBinPatcher::createBinFilesForPatchList()
             return false;
     }
 
+    TFileFinder Finder;
     for (size_t i = 0; i < Count; ++i)
-        splice(&m_BinFilesForPatch, findFiles(m_QtDir + Elements[i].Dir, Elements[i].Name));
+        Finder.add(m_QtDir + Elements[i].Dir, Elements[i].Name, false);
+    Finder.setInventory(m_QtDir + "/.bin.qtbpinv");
+    m_BinFilesForPatch = Finder.find(m_Jobs);
 
     LOG_V("\nList of binary files for patch:\n%s\n",
           stringListToStr(m_BinFilesForPatch, "  ", "\n").c_str());
@@ -384,109 +600,452 @@ bool TQtBinPatcher::createBinFilesForPatchList()
 }
 
 //------------------------------------------------------------------------------
+// Lists of files are searched and files without patched values are dropped.
+
+bool TQtBinPatcher::createFilesForPatchLists()
+{
+    if (!createTxtFilesForPatchList() || !createBinFilesForPatchList())
+        return false;
+    filterFiles(&m_TxtFilesForPatch, &TQtBinPatcher::hasTxtChanges, "Files without patched values");
+    filterFiles(&m_BinFilesForPatch, &TQtBinPatcher::hasBinSlots, "Files without patched values");
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Splitting ranges by symbols: parts of ranges outside symbols and parts of
+// symbols inside ranges are returned in order of offsets.
+
+static void splitRanges(TFileRanges* pRanges, TFileRanges symbols)
+{
+    sort(pRanges->begin(), pRanges->end());
+    sort(symbols.begin(), symbols.end());
+
+    TFileRanges Result;
+    for (TFileRanges::const_iterator Range = pRanges->begin(); Range != pRanges->end(); ++Range) {
+        const size_t End = Range->Offset + Range->Size;
+        size_t Pos = Range->Offset;
+        for (TFileRanges::const_iterator Symbol = symbols.begin(); Symbol != symbols.end(); ++Symbol) {
+            const size_t SymbolBegin = max(Symbol->Offset, Pos);
+            const size_t SymbolEnd = min(Symbol->Offset + Symbol->Size, End);
+            if (SymbolBegin >= SymbolEnd)
+                continue;
+            if (SymbolBegin > Pos)
+                Result.push_back(TFileRange(Pos, SymbolBegin - Pos));
+            Result.push_back(TFileRange(SymbolBegin, SymbolEnd - SymbolBegin));
+            Pos = SymbolEnd;
+        }
+        if (Pos < End)
+            Result.push_back(TFileRange(Pos, End - Pos));
+    }
+    pRanges->swap(Result);
+}
+
+//------------------------------------------------------------------------------
+// Getting ranges of binary file, which can contain slots: data sections of
+// ELF and PE files or the whole file if there is no information about its
+// structure. In ELF files "qt_configure_*" symbols split data sections, so
+// slots in symbols end with symbols. Returns name of file format or NULL.
+
+const char* TQtBinPatcher::getBinRanges(const char* data, size_t size, TFileRanges* pRanges) const
+{
+    const char* Format = NULL;
+    TFileRanges Symbols;
+    pRanges->clear();
+    if (TElfFile::isElf(data, size)) {
+        Format = "ELF";
+        TElfFile Elf(data, size);
+        Elf.getSymbolRanges("qt_configure_", &Symbols);
+        Elf.getDataRanges(pRanges);
+    }
+    else if (TPeFile::isPe(data, size)) {
+        Format = "PE";
+        TPeFile(data, size).getDataRanges(pRanges);
+    }
+
+    if (pRanges->empty())
+        pRanges->push_back(TFileRange(0, size));
+    splitRanges(pRanges, Symbols);
+    return Format;
+}
+
+//------------------------------------------------------------------------------
+// Searching for slots in binary file. Slots are searched in all data sections
+// including "qt_configure_*" symbols: symbols only bound slots, so slots
+// outside of them are found too.
+
+void TQtBinPatcher::findBinSites(const char* data, size_t size, TSlotMatcher::TSites* pSites, TFileRanges* pRanges) const
+{
+    const char* const Format = getBinRanges(data, size, pRanges);
+    const TFileRanges& Ranges = *pRanges;
+    if (Ranges.size() == 1 && Ranges.front().Offset == 0 && Ranges.front().Size == size) {
+        if (Format != NULL)
+            LOG_V("  %s data sections not found. Scanning whole file.\n", Format);
+    }
+    else {
+        size_t Bytes = 0;
+        for (TFileRanges::const_iterator Iter = Ranges.begin(); Iter != Ranges.end(); ++Iter)
+            Bytes += Iter->Size;
+        LOG_V("  Scanning %u ranges of %s data sections (%lu of %lu bytes).\n",
+              static_cast<unsigned int>(Ranges.size()), Format,
+              static_cast<unsigned long>(Bytes), static_cast<unsigned long>(size));
+    }
+    m_BinMatcher.find(data, Ranges, pSites, m_Jobs);
+}
+
+//------------------------------------------------------------------------------
+// Searching for matches in text. If all replacements have the same length,
+// matches, which already have the new value, are dropped.
+
+void TQtBinPatcher::findTxtChanges(const char* data, size_t size, TTextMatches* pMatches) const
+{
+    m_TxtReplacer.find(data, size, pMatches);
+    if (m_TxtReplacer.isSameLength(*pMatches)) {
+        TTextMatches::iterator Last = pMatches->begin();
+        for (TTextMatches::const_iterator Iter = pMatches->begin(); Iter != pMatches->end(); ++Iter) {
+            const string& To = m_TxtReplacer.to(Iter->Pattern);
+            if (memcmp(data + Iter->Offset, To.data(), To.length()) != 0)
+                *Last++ = *Iter;
+        }
+        pMatches->erase(Last, pMatches->end());
+    }
+}
+
+//------------------------------------------------------------------------------
+// Prefilter of text files: file is needed if it has something to change.
+// Files, which can't be read here, are kept (errors are reported by patching).
+
+bool TQtBinPatcher::hasTxtChanges(const string& fileName) const
+{
+    uint64_t Size = 0, Time = 0;
+    TMappedFile File;
+    if (!getFileInfo(fileName, &Size, &Time) || !File.open(fileName))
+        return true;
+    if (Size == 0)
+        return false;
+
+    TTextMatches Matches;
+    findTxtChanges(File.data(), File.size(), &Matches);
+    return !Matches.empty();
+}
+
+//------------------------------------------------------------------------------
+// Prefilter of binary files: file is needed if its valid site index has
+// slots or if ranges scanned by findBinSites() contain some key.
+
+bool TQtBinPatcher::hasBinSlots(const string& fileName) const
+{
+    TSiteIndex Index(fileName);
+    TSlotMatcher::TSites Sites;
+    if (Index.load() && getIndexedSites(fileName, Index, &Sites))
+        return !Sites.empty();
+
+    uint64_t Size = 0, Time = 0;
+    TMappedFile File;
+    if (!getFileInfo(fileName, &Size, &Time) || !File.open(fileName))
+        return true;
+    TFileRanges Ranges;
+    getBinRanges(File.data(), File.size(), &Ranges);
+    return m_BinMatcher.contains(File.data(), Ranges);
+}
+
+//------------------------------------------------------------------------------
+// File must be patched on resuming, if it was not done or was changed since.
+
+bool TQtBinPatcher::isNotDone(const string& fileName) const
+{
+    return !m_pCheckpoint->isDone(fileName);
+}
+
+//------------------------------------------------------------------------------
+// Removing files, which need no patching, from list before backup. Files are
+// checked in several threads; order of list is kept.
+
+void TQtBinPatcher::filterFiles(TStringList* pFiles, bool (TQtBinPatcher::*isNeeded)(const string&) const, const char* skippedTitle) const
+{
+    TFilterJob Job(this, isNeeded, *pFiles);
+    if (m_Jobs <= 1 || pFiles->size() <= 1) {
+        for (size_t i = 0; i < pFiles->size(); ++i)
+            Job.run(i);
+    }
+    else {
+        TThreadPool::run(&Job, pFiles->size(), m_Jobs);
+    }
+
+    TStringList Skipped;
+    Job.getFiles(pFiles, &Skipped);
+    if (!Skipped.empty())
+        LOG_V("\n%s (skipped):\n%s\n", skippedTitle,
+              stringListToStr(Skipped, "  ", "\n").c_str());
+}
+
+//------------------------------------------------------------------------------
+// Recording of text file as done in checkpoint. Hash of written range is
+// taken from new content in buffer, so the file isn't read back.
+
+bool TQtBinPatcher::addTxtDone(const string& fileName, const vector<char>& buf, const TFileRange& written) const
+{
+    if (m_pCheckpoint == NULL)
+        return true;
+
+    TFileRanges Ranges;
+    if (written.Size > 0)
+        Ranges.push_back(written);
+    return m_pCheckpoint->addDone(fileName, buf.size(), Ranges,
+                                  Functions::hash(buf.data() + written.Offset, written.Size));
+}
+
+//------------------------------------------------------------------------------
+// Patched file is recorded in checkpoint (files without changes too, so they
+// are not checked again on resuming).
 
 bool TQtBinPatcher::patchTxtFile(const string& fileName)
 {
     LOG("Patching text file \"%s\".\n", fileName.c_str());
 
-    bool Result = false;
+    // File is opened for writing only if its content must be changed.
+    FILE* File = fopen(fileName.c_str(), "rb");
+    if (File == NULL) {
+        LOG_E("Error opening file \"%s\". Error %i.\n", fileName.c_str(), errno);
+        return false;
+    }
 
-    FILE* File = fopen(fileName.c_str(), "r+b");
-    if (File!= NULL)
-    {
-        vector<char> Buf;
-        long FileLength = getFileSize(File);
-
-        if (FileLength > 0)
-        {
-            Buf.resize(FileLength);
-            if (fread(Buf.data(), FileLength, 1, File) == 1) // TODO: C++11 requred!
-            {
-                for (TStringMap::const_iterator Iter = m_TxtPatchValues.begin(); Iter != m_TxtPatchValues.end(); ++Iter)
-                {
-                    string::size_type Delta = 0;
-                    vector<char>::iterator Found;
-                    while ((Found = search(Buf.begin() + Delta, Buf.end(),
-                                           Iter->first.begin(), Iter->first.end()
-                                           #ifdef OS_WINDOWS
-                                               , caseInsensitiveComp
-                                           #endif
-                            ))
-                           != Buf.end())
-                    {
-                        Delta = Found - Buf.begin() + static_cast<int>(Iter->second.length());
-                        Found = Buf.erase(Found, Found + Iter->first.length());
-                        Buf.insert(Found, Iter->second.begin(), Iter->second.end());
-                    }
-                }
-                zeroFile(File);
-                if (fwrite(Buf.data(), Buf.size(), 1, File) == 1)
-                    Result = true;
-                else
-                    LOG_E("Error writing to file \"%s\".\n", fileName.c_str());
-            }
-            else {
-                LOG_E("Error reading from file \"%s\".\n", fileName.c_str());
-            }
+    vector<char> Buf;
+    const int64_t FileLength = getFileSize(File);
+    bool Result = true;
+    if (FileLength > 0) {
+        Buf.resize(static_cast<size_t>(FileLength));
+        if (fread(Buf.data(), Buf.size(), 1, File) != 1) { // TODO: C++11 requred!
+            LOG_E("Error reading from file \"%s\".\n", fileName.c_str());
+            Result = false;
+        }
+    }
+    fclose(File);
+    if (!Result)
+        return false;
+
+    if (Buf.empty()) {
+        LOG_V("  File is empty. Skipping.\n");
+        return addTxtDone(fileName, Buf, TFileRange(0, 0));
+    }
+
+    TTextMatches Matches;
+    findTxtChanges(Buf.data(), Buf.size(), &Matches);
+    const bool SameLength = m_TxtReplacer.isSameLength(Matches);
+    if (Matches.empty()) {
+        LOG_V("  Nothing to replace. Skipping.\n");
+        return addTxtDone(fileName, Buf, TFileRange(0, 0));
+    }
+
+    // In atomic mode the original file is kept as backup (hard link), so it
+    // is never changed in place.
+    if (m_Atomic) {
+        m_TxtReplacer.apply(Matches, &Buf);
+        return writeFileAtomic(fileName, Buf.data(), Buf.size()) &&
+               addTxtDone(fileName, Buf, TFileRange(0, Buf.size()));
+    }
+
+    // Original bytes of parts, which will be written, go to journal first.
+    if (m_pJournal != NULL) {
+        TFileRanges Ranges;
+        if (SameLength) {
+            for (TTextMatches::const_iterator Iter = Matches.begin(); Iter != Matches.end(); ++Iter)
+                Ranges.push_back(TFileRange(Iter->Offset, m_TxtReplacer.from(Iter->Pattern).length()));
         }
         else {
-            LOG_V("  File is empty. Skipping.\n");
-            Result = true;
+            Ranges.push_back(TFileRange(Matches.front().Offset, Buf.size() - Matches.front().Offset));
         }
+        if (!m_pJournal->add(fileName, Buf.data(), Buf.size(), Ranges))
+            return false;
+    }
 
-        fclose(File);
+    File = fopen(fileName.c_str(), "r+b");
+    if (File == NULL) {
+        LOG_E("Error opening file \"%s\". Error %i.\n", fileName.c_str(), errno);
+        return false;
+    }
+
+    // Buffer gets new content of written range.
+    const size_t First = Matches.front().Offset;
+    size_t End = Buf.size();
+    if (SameLength) {
+        // Only replaced parts are written.
+        for (TTextMatches::const_iterator Iter = Matches.begin(); Result && Iter != Matches.end(); ++Iter) {
+            const string& To = m_TxtReplacer.to(Iter->Pattern);
+            Result = seekFile(File, Iter->Offset) &&
+                     fwrite(To.data(), To.length(), 1, File) == 1;
+            memcpy(&Buf[Iter->Offset], To.data(), To.length());
+            End = Iter->Offset + To.length();
+        }
     }
     else {
+        // File is rewritten from the first replaced part.
+        m_TxtReplacer.apply(Matches, &Buf);
+        Result = seekFile(File, First) &&
+                 fwrite(Buf.data() + First, Buf.size() - First, 1, File) == 1 &&
+                 resizeFile(File, Buf.size());
+    }
+
+    if (fclose(File) != 0)
+        Result = false;
+    if (!Result) {
+        LOG_E("Error writing to file \"%s\". Error %i.\n", fileName.c_str(), errno);
+        return false;
+    }
+    return addTxtDone(fileName, Buf, TFileRange(First, End - First));
+}
+
+//------------------------------------------------------------------------------
+// Writing new values into slots of binary file.
+
+bool TQtBinPatcher::writeBinSites(const string& fileName, const TSlotMatcher::TSites& sites) const
+{
+    FILE* File = fopen(fileName.c_str(), "r+b");
+    if (File == NULL) {
         LOG_E("Error opening file \"%s\". Error %i.\n", fileName.c_str(), errno);
+        return false;
+    }
+
+    bool Result = true;
+    for (TSlotMatcher::TSites::const_iterator Iter = sites.begin(); Result && Iter != sites.end(); ++Iter) {
+        const string& Value = m_BinMatcher.value(Iter->Value);
+        Result = seekFile(File, Iter->Offset) &&
+                 fwrite(Value.c_str(), Value.length() + 1, 1, File) == 1;
+    }
+
+    if (fclose(File) != 0)
+        Result = false;
+    if (!Result)
+        LOG_E("Error writing to file \"%s\". Error %i.\n", fileName.c_str(), errno);
+    return Result;
+}
+
+//------------------------------------------------------------------------------
+// Getting sites of binary file from its site index. Returns false if index
+// doesn't match the file; then the file must be searched.
+
+bool TQtBinPatcher::getIndexedSites(const string& fileName, const TSiteIndex& index, TSlotMatcher::TSites* pSites) const
+{
+    FILE* File = fopen(fileName.c_str(), "rb");
+    if (File == NULL)
+        return false;
+
+    // All slots must still hold known keys and new values must fit into them.
+    bool Result = index.check(File);
+    char Key[TSlotMatcher::KeyLength];
+    const TSiteIndex::TSlots& Slots = index.slots();
+    for (TSiteIndex::TSlots::const_iterator Iter = Slots.begin(); Result && Iter != Slots.end(); ++Iter)
+    {
+        size_t Value = string::npos;
+        if (seekFile(File, Iter->Offset) &&
+            fread(Key, sizeof(Key), 1, File) == 1)
+            Value = m_BinMatcher.lookup(Key);
+        Result = Value != string::npos && m_BinMatcher.value(Value).length() < Iter->Length;
+        if (Result)
+            pSites->push_back(TSlotMatcher::TSite(Iter->Offset, Value));
     }
 
+    fclose(File);
     return Result;
 }
 
+//------------------------------------------------------------------------------
+// Removing sites, which already hold new values.
+
+void TQtBinPatcher::removeWrittenSites(const char* data, TSlotMatcher::TSites* pSites) const
+{
+    TSlotMatcher::TSites::iterator Last = pSites->begin();
+    for (TSlotMatcher::TSites::const_iterator Iter = pSites->begin(); Iter != pSites->end(); ++Iter) {
+        const string& Value = m_BinMatcher.value(Iter->Value);
+        if (memcmp(data + Iter->Offset, Value.c_str(), Value.length() + 1) != 0)
+            *Last++ = *Iter;
+    }
+    pSites->erase(Last, pSites->end());
+}
+
 //------------------------------------------------------------------------------
 
 bool TQtBinPatcher::patchBinFile(const string& fileName)
 {
     LOG("Patching binary file \"%s\".\n", fileName.c_str());
 
-    bool Result = false;
+    // File is searched in read-only mapping and opened for writing only if
+    // some slots must be changed.
+    TMappedFile File;
+    if (!File.open(fileName))
+        return false;
 
-    FILE* File = fopen(fileName.c_str(), "r+b");
-    if (File != NULL)
-    {
-        long BufSize = getFileSize(File);
-        char* Buf = new char[BufSize];
-
-        if (fread(Buf, BufSize, 1, File) == 1)
-        {
-            for (TStringMap::const_iterator Iter = m_BinPatchValues.begin(); Iter != m_BinPatchValues.end(); ++Iter)
-            {
-                char* First = Buf;
-                while ((First = search(First, Buf + BufSize,
-                                       Iter->first.begin(), Iter->first.end()))
-                       != Buf + BufSize)
-                {
-                    strcpy(First, Iter->second.c_str());
-                    First += Iter->second.length();
-                }
-            }
-            rewind(File);
-            if (fwrite(Buf, BufSize, 1, File) == 1)
-                Result = true;
-            else
-                LOG_E("Error writing to file \"%s\".\n", fileName.c_str());
-        }
-        else {
-            LOG_E("Error reading from file \"%s\".\n", fileName.c_str());
+    TSiteIndex Index(fileName);
+    TSlotMatcher::TSites Sites;
+    const bool Indexed = Index.load() && getIndexedSites(fileName, Index, &Sites);
+    if (Indexed) {
+        LOG_V("  Using site index (%u slots).\n", static_cast<unsigned int>(Sites.size()));
+    }
+    else {
+        Sites.clear();
+        TFileRanges Ranges;
+        findBinSites(File.data(), File.size(), &Sites, &Ranges);
+
+        // Slot can't last behind the next slot or the end of scanned range
+        // (sites are ordered by offset within each range).
+        TSiteIndex::TSlots Slots;
+        TFileRanges::const_iterator Range = Ranges.begin();
+        for (TSlotMatcher::TSites::const_iterator Iter = Sites.begin(); Iter != Sites.end(); ++Iter) {
+            while (Range->Offset + Range->Size <= Iter->Offset)
+                ++Range;
+            size_t End = Range->Offset + Range->Size;
+            if (Iter + 1 != Sites.end() && Iter[1].Offset < End)
+                End = Iter[1].Offset;
+            Slots.push_back(TSiteIndex::TSlot(Iter->Offset, TSlotMatcher::slotLength(File.data(), Iter->Offset, End)));
         }
+        Index.setSlots(Slots);
+    }
 
-        delete[] Buf;
-        fclose(File);
+    // Written ranges go to journal before writing and to checkpoint after it
+    // (with hash of new values, so the file isn't read back).
+    removeWrittenSites(File.data(), &Sites);
+    const size_t FileSize = File.size();
+    TFileRanges Ranges;
+    uint64_t Hash = Functions::hash(NULL, 0);
+    for (TSlotMatcher::TSites::const_iterator Iter = Sites.begin(); Iter != Sites.end(); ++Iter) {
+        const string& Value = m_BinMatcher.value(Iter->Value);
+        Ranges.push_back(TFileRange(Iter->Offset, Value.length() + 1));
+        Hash = Functions::hash(Value.c_str(), Value.length() + 1, Hash);
     }
-    else {
-        LOG_E("Error opening file \"%s\". Error %i.\n", fileName.c_str(), errno);
+    if (m_pJournal != NULL && !Sites.empty() &&
+        !m_pJournal->add(fileName, File.data(), File.size(), Ranges))
+        return false;
+    File.close();
+
+    if (Sites.empty()) {
+        LOG_V("  Nothing to replace. Skipping.\n");
+    }
+    else if (!writeBinSites(fileName, Sites)) {
+        return false;
     }
 
+    // Index stays valid if the file was not changed.
+    if (!Indexed || !Sites.empty())
+        Index.save();
+
+    return m_pCheckpoint == NULL || m_pCheckpoint->addDone(fileName, FileSize, Ranges, Hash);
+}
+
+//------------------------------------------------------------------------------
+// Patching of files from list. In several threads files are patched by
+// TPatchJob.
+
+bool TQtBinPatcher::patchFiles(const TStringList& files, bool (TQtBinPatcher::*patchFile)(const string&))
+{
+    if (m_Jobs <= 1 || files.size() <= 1) {
+        for (TStringList::const_iterator Iter = files.begin(); Iter != files.end(); ++Iter)
+            if (!(this->*patchFile)(*Iter))
+                return false;
+        return true;
+    }
+
+    TPatchJob Job(this, patchFile, files);
+    const bool Result = TThreadPool::run(&Job, files.size(), m_Jobs);
+    Job.flushLogs();
     return Result;
 }
 
@@ -494,64 +1053,294 @@ bool TQtBinPatcher::patchBinFile(const string& fileName)
 
 bool TQtBinPatcher::patchTxtFiles()
 {
-    for (TStringList::const_iterator Iter = m_TxtFilesForPatch.begin(); Iter != m_TxtFilesForPatch.end(); ++Iter)
-        if (!patchTxtFile(*Iter))
-            return false;
-    return true;
+    return patchFiles(m_TxtFilesForPatch, &TQtBinPatcher::patchTxtFile);
 }
 
 //------------------------------------------------------------------------------
 
 bool TQtBinPatcher::patchBinFiles()
 {
-    for (TStringList::const_iterator Iter = m_BinFilesForPatch.begin(); Iter != m_BinFilesForPatch.end(); ++Iter)
-        if (!patchBinFile(*Iter))
+    return patchFiles(m_BinFilesForPatch, &TQtBinPatcher::patchBinFile);
+}
+
+//------------------------------------------------------------------------------
+// Replacing names of files by names of their targets in Qt directory (see
+// TShadowTree::realFileName()). Several links to one file give one name.
+
+static void getRealFileNames(const TShadowTree& shadow, TStringList* pFiles)
+{
+    TStringSet Files;
+    TStringList::iterator Iter = pFiles->begin();
+    while (Iter != pFiles->end()) {
+        *Iter = shadow.realFileName(*Iter);
+        if (Files.insert(*Iter).second)
+            ++Iter;
+        else
+            Iter = pFiles->erase(Iter);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Patching in shadow tree near Qt directory. Patched files are copied into
+// shadow tree, other files are hard links, qt.conf is dropped. Symbolic links
+// stay links: their targets are patched. Then shadow tree replaces Qt
+// directory at once. The old tree is kept as "<Qt directory>.bak" with
+// option "--backup", otherwise it is removed. On errors shadow tree is
+// removed and Qt directory stays untouched.
+
+bool TQtBinPatcher::patchShadowTree()
+{
+    const string BakDir = m_ArgsMap.contains(OPT_BACKUP) ? m_QtDir + ".bak" : string();
+    if (!BakDir.empty() && isFileExists(BakDir)) {
+        LOG_E("Directory \"%s\" for backup already exists.\n", BakDir.c_str());
+        return false;
+    }
+
+    if (!checkPatchNeeded())
+        return true;
+    if (!createPatchValues() || !createFilesForPatchLists())
+        return false;
+
+    TShadowTree Shadow(m_QtDir);
+    getRealFileNames(Shadow, &m_TxtFilesForPatch);
+    getRealFileNames(Shadow, &m_BinFilesForPatch);
+
+    TStringSet Copied(m_TxtFilesForPatch.begin(), m_TxtFilesForPatch.end());
+    Copied.insert(m_BinFilesForPatch.begin(), m_BinFilesForPatch.end());
+    TStringSet Excluded;
+    Excluded.insert(m_QtDir + "/bin/qt.conf");
+
+    if (!Shadow.create(Copied, Excluded))
+        return false;
+
+    // Patched file must not be shared with Qt directory.
+    for (TStringList::iterator Iter = m_TxtFilesForPatch.begin(); Iter != m_TxtFilesForPatch.end(); ++Iter) {
+        *Iter = Shadow.shadowFileName(*Iter);
+        if (!Shadow.isCopy(*Iter))
             return false;
+    }
+    for (TStringList::iterator Iter = m_BinFilesForPatch.begin(); Iter != m_BinFilesForPatch.end(); ++Iter) {
+        *Iter = Shadow.shadowFileName(*Iter);
+        if (!Shadow.isCopy(*Iter))
+            return false;
+    }
+
+    if (!patchTxtFiles() || !patchBinFiles())
+        return false;
+    return Shadow.publish(BakDir);
+}
+
+//------------------------------------------------------------------------------
+// Loading checkpoint of interrupted run and its backup. If the run didn't
+// start to change files, its backup (of qt.conf) is restored and the run is
+// made anew. On errors checkpoint and backup are kept as is.
+
+bool TQtBinPatcher::loadCheckpoint(TBackup* pBackup, bool* pResumed)
+{
+    *pResumed = false;
+    if (!m_pCheckpoint->load())
+        return false;
+
+    if (strneq(m_pCheckpoint->newQtDir(), m_NewQtDir)) {
+        LOG_E("Interrupted run was made for other new Qt directory \"%s\".\n",
+              m_pCheckpoint->newQtDir().c_str());
+        m_pCheckpoint->close();
+        return false;
+    }
+
+    pBackup->setSkipBackup(m_pCheckpoint->noBackup());
+    if (!pBackup->resume(*m_pCheckpoint)) {
+        pBackup->save();
+        m_pCheckpoint->close();
+        return false;
+    }
+
+    *pResumed = m_pCheckpoint->isStarted();
+    if (!*pResumed) {
+        LOG("\nInterrupted run didn't start patching. Starting anew.\n");
+        if (!pBackup->restore()) {
+            m_pCheckpoint->close();
+            return false;
+        }
+    }
     return true;
 }
 
+//------------------------------------------------------------------------------
+// Resuming of interrupted run. Patch values and lists of files are taken from
+// checkpoint (old values can't be asked from qmake, it may be patched).
+// Files, which are done, are skipped. Other files may be partially patched,
+// so they are restored from backup before patching (copies kept in memory
+// are lost, such files are patched as they are).
+
+bool TQtBinPatcher::resume(TBackup* pBackup)
+{
+    LOG("\nResuming interrupted run.\n");
+
+    m_TxtPatchValues = m_pCheckpoint->txtPatchValues();
+    m_BinPatchValues = m_pCheckpoint->binPatchValues();
+    if (!initPatchValues())
+        return false;
+
+    m_TxtFilesForPatch = m_pCheckpoint->txtFiles();
+    m_BinFilesForPatch = m_pCheckpoint->binFiles();
+    filterFiles(&m_TxtFilesForPatch, &TQtBinPatcher::isNotDone, "Files done by interrupted run");
+    filterFiles(&m_BinFilesForPatch, &TQtBinPatcher::isNotDone, "Files done by interrupted run");
+
+    TStringList Files = m_TxtFilesForPatch;
+    Files.insert(Files.end(), m_BinFilesForPatch.begin(), m_BinFilesForPatch.end());
+    return pBackup->restoreFiles(Files);
+}
+
+//------------------------------------------------------------------------------
+// Restoring of all files changed by interrupted run. Temporary files of text
+// files written in atomic mode are removed. If it fails, checkpoint is kept
+// for next try.
+
+bool TQtBinPatcher::rollback(TBackup* pBackup)
+{
+    if (!m_pCheckpoint->load())
+        return false;
+
+    if (m_pCheckpoint->noBackup()) {
+        LOG_E("Interrupted run was made without backup. Files can't be restored.\n");
+        m_pCheckpoint->close();
+        return false;
+    }
+
+    LOG("\nRolling back interrupted run.\n");
+    if (!pBackup->resume(*m_pCheckpoint)) {
+        pBackup->save();
+        m_pCheckpoint->close();
+        return false;
+    }
+
+    bool Result = pBackup->restore();
+    const TStringList& Files = m_pCheckpoint->txtFiles();
+    for (TStringList::const_iterator Iter = Files.begin(); Iter != Files.end(); ++Iter)
+        if (!removeFile(tempFileName(*Iter)))
+            Result = false;
+
+    if (!Result) {
+        m_pCheckpoint->close();
+        return false;
+    }
+
+    // Nothing more can be done for these files, checkpoint isn't kept.
+    const TStringList& Lost = m_pCheckpoint->memoryBackups();
+    if (!Lost.empty()) {
+        LOG_E("Originals of files were kept in memory by interrupted run and can't be restored:\n%s",
+              stringListToStr(Lost, "  ", "\n").c_str());
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Restoring all files from archive kept by finished run to their places.
+// Qt isn't needed for it (qmake may be restored too). Archive isn't changed,
+// so it can be used again.
+
+bool TQtBinPatcher::restoreArchive(const string& fileName)
+{
+    TBackupArchive Archive(fileName);
+    if (!Archive.open(true))
+        return false;
+
+    LOG("\nRestoring files from archive \"%s\".\n", fileName.c_str());
+    const bool Result = Archive.restore();
+    Archive.close();
+    return Result;
+}
+
 //------------------------------------------------------------------------------
 
 bool TQtBinPatcher::exec()
 {
     if (!getQtDir())
         return false;
+
+    // Checkpoint is removed at return: run is finished or is rolled back
+    // by backup. It stays if process is killed or if backup can't be
+    // restored or removed.
+    TCheckpoint Checkpoint(m_QtDir + "/.qtbpcheckpoint");
+    m_pCheckpoint = &Checkpoint;
+    TBackup Backup;
+    Backup.setCheckpoint(&Checkpoint);
+    if (m_ArgsMap.contains(OPT_ROLLBACK))
+        return rollback(&Backup);
+
     if (!getNewQtDir())
         return false;
+    if (!getJobs())
+        return false;
+    if (!getBackupMemory())
+        return false;
+    Backup.setMemoryLimit(m_BackupMemory);
 
-    TBackup Backup;
-    Backup.setSkipBackup(m_ArgsMap.contains(OPT_NOBACKUP));
-    if (!Backup.backupFile(m_QtDir + "/bin/qt.conf", TBackup::bmRename))
+    if (!m_ArgsMap.contains(OPT_RESUME) && isFileExists(Checkpoint.fileName())) {
+        LOG_E("Found checkpoint \"%s\" of interrupted run.\n"
+              "Use option \"--resume\" or \"--rollback\".\n", Checkpoint.fileName().c_str());
         return false;
+    }
 
-    if (!isPatchNeeded()) {
-        if (m_ArgsMap.contains(OPT_FORCE)) {
-            LOG("\nThe new and the old pathes to Qt directory are the same.\n"
-                "Perform forced patching.\n\n");
-        }
-        else {
-            LOG("\nThe new and the old pathes to Qt directory are the same.\n"
-                "Patching not needed.\n");
-            return true;
-        }
+    // Qt directory isn't changed until shadow tree is published, so neither
+    // backup nor checkpoint is needed.
+    if (m_ArgsMap.contains(OPT_SHADOW_TREE)) {
+        m_pCheckpoint = NULL;
+        return patchShadowTree();
     }
 
-    createPatchValues();
-    if (!createTxtFilesForPatchList() || !createBinFilesForPatchList())
+    bool Resumed = false;
+    if (m_ArgsMap.contains(OPT_RESUME) && !loadCheckpoint(&Backup, &Resumed))
         return false;
 
-    if (!Backup.backupFiles(m_TxtFilesForPatch) || !Backup.backupFiles(m_BinFilesForPatch))
+    if (Resumed) {
+        if (!resume(&Backup))
+            return false;
+    }
+    else {
+        if (!Checkpoint.create(m_NewQtDir, m_ArgsMap.contains(OPT_NOBACKUP)))
+            return false;
+        Backup.setSkipBackup(m_ArgsMap.contains(OPT_NOBACKUP));
+        if (m_ArgsMap.contains(OPT_BACKUP_ARCHIVE) && !Backup.setArchive(m_ArgsMap.value(OPT_BACKUP_ARCHIVE)))
+            return false;
+        if (m_ArgsMap.contains(OPT_BACKUP_JOURNAL) && !Backup.setJournal(m_ArgsMap.value(OPT_BACKUP_JOURNAL)))
+            return false;
+        if (!Backup.backupFile(m_QtDir + "/bin/qt.conf", TBackup::bmRename))
+            return false;
+
+        if (!checkPatchNeeded())
+            return true;
+
+        if (!createPatchValues() || !Checkpoint.addPatchValues(m_TxtPatchValues, m_BinPatchValues))
+            return false;
+        if (!createFilesForPatchLists() || !Checkpoint.addFiles(m_TxtFilesForPatch, m_BinFilesForPatch))
+            return false;
+    }
+    m_pJournal = Backup.journal();
+
+    // Text files are replaced in atomic mode, so the original files can
+    // stay as backup. Binary files are always changed in place.
+    const TBackup::TBackupMethod TxtBackupMethod = m_Atomic ? TBackup::bmLink : TBackup::bmCopy;
+    if (!Backup.backupFiles(m_TxtFilesForPatch, TxtBackupMethod) || !Backup.backupFiles(m_BinFilesForPatch))
         return false;
 
     if (!patchTxtFiles() || !patchBinFiles())
         return false;
 
     // Finalization.
-    if (m_ArgsMap.contains(OPT_BACKUP))
-        Backup.save();
+    if (m_ArgsMap.contains(OPT_BACKUP)) {
+        if (!Backup.save()) {
+            LOG_E("Backup of original files is not saved completely.\n");
+            return false;
+        }
+    }
     else
-        if (!Backup.remove())
+        if (!Backup.remove()) {
+            Checkpoint.close();
             return false;
+        }
 
     return true;
 }
@@ -561,6 +1350,11 @@ bool TQtBinPatcher::exec()
 TQtBinPatcher::TQtBinPatcher(const TStringListMap& argsMap)
     : m_ArgsMap(argsMap),
       m_QMake(getStartDir()),
+      m_Atomic(argsMap.contains(OPT_ATOMIC)),
+      m_Jobs(1),
+      m_BackupMemory(0),
+      m_pJournal(NULL),
+      m_pCheckpoint(NULL),
       m_hasError(false)
 {
     if (m_QMake.hasError()) {
@@ -576,6 +1370,9 @@ TQtBinPatcher::TQtBinPatcher(const TStringListMap& argsMap)
 
 bool TQtBinPatcher::exec(const TStringListMap& argsMap)
 {
+    if (argsMap.contains(OPT_RESTORE_ARCHIVE))
+        return restoreArchive(argsMap.value(OPT_RESTORE_ARCHIVE));
+
     TQtBinPatcher QtBinPatcher(argsMap);
     return !QtBinPatcher.m_hasError;
 }
@@ -34,9 +34,20 @@
 
 //------------------------------------------------------------------------------
 
+#include <stdint.h>
+
 #include "CommonTypes.hpp"
 //#include "CmdLineParser.hpp"
 #include "QMake.hpp"
+#include "TextReplacer.hpp"
+#include "SlotMatcher.hpp"
+#include "SiteIndex.hpp"
+#include "BackupJournal.hpp"
+#include "Checkpoint.hpp"
+
+//------------------------------------------------------------------------------
+
+class TBackup;
 
 //------------------------------------------------------------------------------
 
@@ -48,25 +59,54 @@ class TQtBinPatcher
         std::string m_NewQtDir;
         TStringMap  m_TxtPatchValues;
         TStringMap  m_BinPatchValues;
+        TTextReplacer m_TxtReplacer;
+        TSlotMatcher  m_BinMatcher;
         TStringList m_TxtFilesForPatch;
         TStringList m_BinFilesForPatch;
         TQMake      m_QMake;
+        bool        m_Atomic;
+        unsigned int m_Jobs;
+        uint64_t    m_BackupMemory;
+        TBackupJournal* m_pJournal;
+        TCheckpoint*    m_pCheckpoint;
         bool        m_hasError;
 
         std::string getStartDir() const;
         bool getQtDir();
         bool getNewQtDir();
+        bool getJobs();
+        bool getBackupMemory();
         bool isPatchNeeded();
+        bool checkPatchNeeded();
         void addTxtPatchValues(const std::string& oldPath);
         void addBinPatchValues(const std::string& oldPath);
         void createBinPatchValues();
-        void createPatchValues();
+        bool initPatchValues();
+        bool createPatchValues();
         bool createTxtFilesForPatchList();
         bool createBinFilesForPatchList();
+        bool createFilesForPatchLists();
+        void findTxtChanges(const char* data, size_t size, TTextMatches* pMatches) const;
+        bool hasTxtChanges(const std::string& fileName) const;
+        bool hasBinSlots(const std::string& fileName) const;
+        bool isNotDone(const std::string& fileName) const;
+        void filterFiles(TStringList* pFiles, bool (TQtBinPatcher::*isNeeded)(const std::string&) const, const char* skippedTitle) const;
+        const char* getBinRanges(const char* data, size_t size, TFileRanges* pRanges) const;
+        void findBinSites(const char* data, size_t size, TSlotMatcher::TSites* pSites, TFileRanges* pRanges) const;
+        bool getIndexedSites(const std::string& fileName, const TSiteIndex& index, TSlotMatcher::TSites* pSites) const;
+        void removeWrittenSites(const char* data, TSlotMatcher::TSites* pSites) const;
+        bool writeBinSites(const std::string& fileName, const TSlotMatcher::TSites& sites) const;
+        bool addTxtDone(const std::string& fileName, const std::vector<char>& buf, const TFileRange& written) const;
         bool patchTxtFile(const std::string& fileName);
         bool patchBinFile(const std::string& fileName);
+        bool patchFiles(const TStringList& files, bool (TQtBinPatcher::*patchFile)(const std::string&));
         bool patchTxtFiles();
         bool patchBinFiles();
+        bool loadCheckpoint(TBackup* pBackup, bool* pResumed);
+        bool resume(TBackup* pBackup);
+        bool rollback(TBackup* pBackup);
+        static bool restoreArchive(const std::string& fileName);
+        bool patchShadowTree();
         bool exec();
 
         TQtBinPatcher(const TStringListMap& argsMap);
@@ -0,0 +1,453 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_REPLACEKERNELS__
+#define __QTBINPATCHER2_REPLACEKERNELS__
+
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "SearchKernel.hpp"
+
+//------------------------------------------------------------------------------
+// Search and replace kernels for text files. Kernel is combined from three
+// policies: case policy, search policy (according to number of patterns) and
+// replacement mode. Every combination is compiled separately, so inner loops
+// don't contain checks for unused features.
+
+//------------------------------------------------------------------------------
+
+struct TTextMatch
+{
+    size_t Offset;
+    size_t Pattern;
+
+    inline TTextMatch(size_t offset, size_t pattern)
+        : Offset(offset), Pattern(pattern) {}
+};
+
+typedef std::vector<TTextMatch>  TTextMatches;
+typedef std::vector<std::string> TPatterns;
+
+//------------------------------------------------------------------------------
+// Case policies.
+
+struct TCaseSensitive
+{
+    static const bool Insensitive = false;
+    static const char* name() { return "case-sensitive"; }
+    static inline unsigned char fold(unsigned char c)
+        { return c; }
+    static inline bool equal(const char* data, const std::string& pattern)
+        { return memcmp(data, pattern.data(), pattern.length()) == 0; }
+};
+
+struct TCaseInsensitive
+{
+    static const bool Insensitive = true;
+    static const char* name() { return "case-insensitive"; }
+    static inline unsigned char fold(unsigned char c)
+        { return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c; }
+    static inline bool equal(const char* data, const std::string& pattern)
+    {
+        for (std::string::size_type i = 0; i < pattern.length(); ++i)
+            if (fold(static_cast<unsigned char>(data[i])) != fold(static_cast<unsigned char>(pattern[i])))
+                return false;
+        return true;
+    }
+};
+
+//------------------------------------------------------------------------------
+// Length of common prefix of all patterns.
+
+template <class TCase>
+size_t commonPrefixLength(const TPatterns& patterns)
+{
+    if (patterns.empty())
+        return 0;
+    size_t Length = patterns[0].length();
+    for (size_t i = 1; i < patterns.size(); ++i) {
+        size_t j = 0;
+        while (j < Length && j < patterns[i].length() &&
+               TCase::fold(static_cast<unsigned char>(patterns[i][j])) ==
+               TCase::fold(static_cast<unsigned char>(patterns[0][j])))
+            ++j;
+        Length = j;
+    }
+    return Length;
+}
+
+//------------------------------------------------------------------------------
+// Search policy for one pattern: anchor candidates and verification.
+
+template <class TCase>
+class TSingleSearch
+{
+    private :
+        std::string m_Pattern;
+        TAnchor     m_Anchor;
+
+    public :
+        static const char* name() { return "single"; }
+
+        void init(const TPatterns& patterns)
+        {
+            m_Pattern = patterns[0];
+            m_Anchor = TAnchor(m_Pattern.data(), m_Pattern.length(), TCase::Insensitive);
+        }
+
+        void find(const char* data, size_t size, TTextMatches* pMatches) const
+        {
+            const char* const End = data + size;
+            const char* p = data;
+            while ((p = TSearchKernel::find(p, End, m_Anchor)) != End) {
+                if (TCase::equal(p, m_Pattern)) {
+                    pMatches->push_back(TTextMatch(p - data, 0));
+                    p += m_Pattern.length();
+                }
+                else {
+                    ++p;
+                }
+            }
+        }
+};
+
+//------------------------------------------------------------------------------
+// Search policy for few patterns with common prefix: anchor candidates by
+// common prefix and verification of patterns from the longest one.
+
+template <class TCase>
+class TSmallSearch
+{
+    private :
+        TPatterns           m_Patterns;
+        std::vector<size_t> m_Order;
+        TAnchor             m_Anchor;
+
+        struct TLongerFirst {
+            const TPatterns& Patterns;
+            TLongerFirst(const TPatterns& patterns) : Patterns(patterns) {}
+            bool operator()(size_t i, size_t j) const
+                { return Patterns[i].length() > Patterns[j].length(); }
+        };
+
+    public :
+        static const size_t MaxPatterns = 8;
+        static const char* name() { return "small"; }
+
+        void init(const TPatterns& patterns)
+        {
+            m_Patterns = patterns;
+            m_Order.clear();
+            for (size_t i = 0; i < patterns.size(); ++i)
+                m_Order.push_back(i);
+            std::stable_sort(m_Order.begin(), m_Order.end(), TLongerFirst(m_Patterns));
+            m_Anchor = TAnchor(patterns[0].data(), commonPrefixLength<TCase>(patterns), TCase::Insensitive);
+        }
+
+        void find(const char* data, size_t size, TTextMatches* pMatches) const
+        {
+            const char* const End = data + size;
+            const char* p = data;
+            while ((p = TSearchKernel::find(p, End, m_Anchor)) != End) {
+                size_t Found = m_Order.size();
+                for (size_t i = 0; i < m_Order.size(); ++i) {
+                    const std::string& Pattern = m_Patterns[m_Order[i]];
+                    if (static_cast<size_t>(End - p) >= Pattern.length() && TCase::equal(p, Pattern)) {
+                        Found = i;
+                        break;
+                    }
+                }
+                if (Found != m_Order.size()) {
+                    pMatches->push_back(TTextMatch(p - data, m_Order[Found]));
+                    p += m_Patterns[m_Order[Found]].length();
+                }
+                else {
+                    ++p;
+                }
+            }
+        }
+};
+
+//------------------------------------------------------------------------------
+// Search policy for many patterns: Aho-Corasick automaton with the full
+// transition table. Matches are leftmost-longest and never overlap.
+
+template <class TCase>
+class TAutomatonSearch
+{
+    private :
+        static const size_t AlphabetSize = 256;
+        static const size_t npos = static_cast<size_t>(-1);
+
+        struct TNode {
+            size_t Depth;
+            size_t Pattern;  // Longest pattern ending in this node or npos.
+        };
+
+        std::vector<size_t> m_Lengths;
+        std::vector<TNode>  m_Nodes;
+        std::vector<size_t> m_Delta;
+        TAnchor             m_Anchor;
+        bool                m_HasAnchor;
+
+        size_t addNode(size_t depth)
+        {
+            TNode Node;
+            Node.Depth = depth;
+            Node.Pattern = npos;
+            m_Nodes.push_back(Node);
+            m_Delta.resize(m_Delta.size() + AlphabetSize, npos);
+            return m_Nodes.size() - 1;
+        }
+
+    public :
+        static const char* name() { return "automaton"; }
+
+        TAutomatonSearch() : m_HasAnchor(false) {}
+
+        void init(const TPatterns& patterns);
+        void find(const char* data, size_t size, TTextMatches* pMatches) const;
+};
+
+template <class TCase> const size_t TAutomatonSearch<TCase>::AlphabetSize;
+template <class TCase> const size_t TAutomatonSearch<TCase>::npos;
+
+//------------------------------------------------------------------------------
+// Building trie of patterns and converting it into the full transition table.
+
+template <class TCase>
+void TAutomatonSearch<TCase>::init(const TPatterns& patterns)
+{
+    m_Lengths.clear();
+    m_Nodes.clear();
+    m_Delta.clear();
+    addNode(0);
+
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        const std::string& Pattern = patterns[i];
+        m_Lengths.push_back(Pattern.length());
+        size_t State = 0;
+        for (std::string::size_type j = 0; j < Pattern.length(); ++j) {
+            const size_t Index = State * AlphabetSize + TCase::fold(static_cast<unsigned char>(Pattern[j]));
+            if (m_Delta[Index] == npos) {
+                const size_t Node = addNode(j + 1);
+                m_Delta[Index] = Node;
+            }
+            State = m_Delta[Index];
+        }
+        // Patterns equal after case folding: the first one wins.
+        if (m_Nodes[State].Pattern == npos)
+            m_Nodes[State].Pattern = i;
+    }
+
+    // Breadth-first traversal: failure links and output propagation.
+    std::vector<size_t> Fail(m_Nodes.size(), 0);
+    std::vector<size_t> Queue;
+    Queue.reserve(m_Nodes.size());
+    for (size_t c = 0; c < AlphabetSize; ++c) {
+        size_t& Next = m_Delta[c];
+        if (Next == npos)
+            Next = 0;
+        else
+            Queue.push_back(Next);
+    }
+    for (size_t Head = 0; Head < Queue.size(); ++Head) {
+        const size_t State = Queue[Head];
+        if (m_Nodes[State].Pattern == npos)
+            m_Nodes[State].Pattern = m_Nodes[Fail[State]].Pattern;
+        for (size_t c = 0; c < AlphabetSize; ++c) {
+            const size_t FailNext = m_Delta[Fail[State] * AlphabetSize + c];
+            size_t& Next = m_Delta[State * AlphabetSize + c];
+            if (Next == npos) {
+                Next = FailNext;
+            }
+            else {
+                Fail[Next] = FailNext;
+                Queue.push_back(Next);
+            }
+        }
+    }
+
+    // Anchor for skipping of data without matches: the first and the last
+    // bytes of common prefix of all patterns.
+    const size_t PrefixLength = commonPrefixLength<TCase>(patterns);
+    m_HasAnchor = PrefixLength > 0;
+    if (m_HasAnchor)
+        m_Anchor = TAnchor(patterns[0].data(), PrefixLength, TCase::Insensitive);
+}
+
+//------------------------------------------------------------------------------
+// The found match is accepted only when the automaton state shows that no
+// longer (or more left) match can start at its position; scanning is then
+// restarted right after it. In the initial state data is skipped up to the
+// next anchor candidate.
+
+template <class TCase>
+void TAutomatonSearch<TCase>::find(const char* data, size_t size, TTextMatches* pMatches) const
+{
+    const unsigned char* const Data = reinterpret_cast<const unsigned char*>(data);
+
+    size_t Pos = 0;
+    size_t State = 0;
+    size_t Pending = npos;
+    size_t PendingStart = 0;
+    for (;;)
+    {
+        if (State == 0 && m_HasAnchor && Pos < size)
+            Pos = TSearchKernel::find(data + Pos, data + size, m_Anchor) - data;
+
+        bool Accept;
+        if (Pos < size) {
+            State = m_Delta[State * AlphabetSize + TCase::fold(Data[Pos])];
+            Accept = Pending != npos && m_Nodes[State].Depth < Pos + 1 - PendingStart;
+        }
+        else {
+            if (Pending == npos)
+                break;
+            Accept = true;
+        }
+
+        if (Accept) {
+            pMatches->push_back(TTextMatch(PendingStart, Pending));
+            Pos = PendingStart + m_Lengths[Pending];
+            State = 0;
+            Pending = npos;
+            continue;
+        }
+
+        const size_t Pattern = m_Nodes[State].Pattern;
+        if (Pattern != npos) {
+            const size_t Start = Pos + 1 - m_Lengths[Pattern];
+            if (Pending == npos || Start < PendingStart ||
+                (Start == PendingStart && m_Lengths[Pattern] > m_Lengths[Pending]))
+            {
+                Pending = Pattern;
+                PendingStart = Start;
+            }
+        }
+        ++Pos;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Replacement modes.
+
+// All replacements have the same length as patterns: buffer is changed in
+// place.
+struct TInPlaceMode
+{
+    static const char* name() { return "in-place"; }
+
+    static void apply(const TPatterns& /*from*/, const TPatterns& to,
+                      const TTextMatches& matches, std::vector<char>* pBuf)
+    {
+        for (TTextMatches::const_iterator Iter = matches.begin(); Iter != matches.end(); ++Iter) {
+            const std::string& To = to[Iter->Pattern];
+            memcpy(pBuf->data() + Iter->Offset, To.data(), To.length());
+        }
+    }
+};
+
+// Length of data changes: result is built in the separate buffer of exact
+// size.
+struct TResizeMode
+{
+    static const char* name() { return "resizing"; }
+
+    static void apply(const TPatterns& from, const TPatterns& to,
+                      const TTextMatches& matches, std::vector<char>* pBuf)
+    {
+        size_t ResultSize = pBuf->size();
+        for (TTextMatches::const_iterator Iter = matches.begin(); Iter != matches.end(); ++Iter)
+            ResultSize = ResultSize - from[Iter->Pattern].length() + to[Iter->Pattern].length();
+
+        std::vector<char> Result(ResultSize);
+        const char* const Src = pBuf->data();
+        char* Dst = Result.data();
+        size_t Pos = 0;
+        for (TTextMatches::const_iterator Iter = matches.begin(); Iter != matches.end(); ++Iter) {
+            const std::string& To = to[Iter->Pattern];
+            memcpy(Dst, Src + Pos, Iter->Offset - Pos);
+            Dst += Iter->Offset - Pos;
+            memcpy(Dst, To.data(), To.length());
+            Dst += To.length();
+            Pos = Iter->Offset + from[Iter->Pattern].length();
+        }
+        memcpy(Dst, Src + Pos, pBuf->size() - Pos);
+        pBuf->swap(Result);
+    }
+};
+
+//------------------------------------------------------------------------------
+// Kernel interface and its implementation for every combination of policies.
+
+class TReplaceKernel
+{
+    public :
+        virtual ~TReplaceKernel() {}
+        virtual void find(const char* data, size_t size, TTextMatches* pMatches) const = 0;
+        virtual void apply(const TTextMatches& matches, std::vector<char>* pBuf) const = 0;
+        virtual std::string name() const = 0;
+};
+
+template <class TCase, template <class> class TSearch, class TMode>
+class TReplaceKernelImpl : public TReplaceKernel
+{
+    private :
+        const TPatterns& m_From;
+        const TPatterns& m_To;
+        TSearch<TCase>   m_Search;
+
+    public :
+        TReplaceKernelImpl(const TPatterns& from, const TPatterns& to)
+            : m_From(from), m_To(to)
+            { m_Search.init(from); }
+
+        virtual void find(const char* data, size_t size, TTextMatches* pMatches) const
+            { m_Search.find(data, size, pMatches); }
+
+        virtual void apply(const TTextMatches& matches, std::vector<char>* pBuf) const
+            { TMode::apply(m_From, m_To, matches, pBuf); }
+
+        virtual std::string name() const
+        {
+            return std::string(TSearch<TCase>::name()) + ", " + TCase::name() + ", " + TMode::name();
+        }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_REPLACEKERNELS__
@@ -0,0 +1,244 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "SearchKernel.hpp"
+
+#include <string.h>
+#include <ctype.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define SEARCH_KERNEL_X86
+    #include <emmintrin.h>
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+//------------------------------------------------------------------------------
+
+#if defined(SEARCH_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define TARGET_SSE2 __attribute__((target("sse2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define TARGET_SSE2
+    #define TARGET_AVX2
+#endif
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TAnchor::TAnchor()
+    : First(0), FirstMask(0), Last(0), LastMask(0), Distance(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TAnchor::TAnchor(const char* str, size_t length, bool caseInsensitive)
+    : First(0), FirstMask(0), Last(0), LastMask(0), Distance(0)
+{
+    if (length > 0) {
+        First = static_cast<unsigned char>(str[0]);
+        Last = static_cast<unsigned char>(str[length - 1]);
+        Distance = length - 1;
+        if (caseInsensitive) {
+            if (isalpha(First)) {
+                First = static_cast<unsigned char>(tolower(First));
+                FirstMask = 0x20;
+            }
+            if (isalpha(Last)) {
+                Last = static_cast<unsigned char>(tolower(Last));
+                LastMask = 0x20;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+static inline bool isAnchor(const unsigned char* p, const TAnchor& anchor)
+{
+    return (p[0] | anchor.FirstMask) == anchor.First &&
+           (p[anchor.Distance] | anchor.LastMask) == anchor.Last;
+}
+
+//------------------------------------------------------------------------------
+
+static const char* findScalar(const char* first, const char* last, const TAnchor& anchor)
+{
+    if (static_cast<size_t>(last - first) <= anchor.Distance)
+        return last;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(first);
+    const unsigned char* const End = reinterpret_cast<const unsigned char*>(last) - anchor.Distance;
+
+    if (anchor.FirstMask == 0) {
+        while ((p = static_cast<const unsigned char*>(memchr(p, anchor.First, End - p))) != NULL) {
+            if ((p[anchor.Distance] | anchor.LastMask) == anchor.Last)
+                return reinterpret_cast<const char*>(p);
+            ++p;
+        }
+        return last;
+    }
+
+    for (; p < End; ++p)
+        if (isAnchor(p, anchor))
+            return reinterpret_cast<const char*>(p);
+    return last;
+}
+
+//------------------------------------------------------------------------------
+
+#ifdef SEARCH_KERNEL_X86
+
+static inline unsigned int lowestBit(unsigned int mask)
+{
+    #ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanForward(&Index, mask);
+        return Index;
+    #else
+        return __builtin_ctz(mask);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+TARGET_SSE2
+static const char* findSse2(const char* first, const char* last, const TAnchor& anchor)
+{
+    const __m128i First     = _mm_set1_epi8(static_cast<char>(anchor.First));
+    const __m128i FirstMask = _mm_set1_epi8(static_cast<char>(anchor.FirstMask));
+    const __m128i Last      = _mm_set1_epi8(static_cast<char>(anchor.Last));
+    const __m128i LastMask  = _mm_set1_epi8(static_cast<char>(anchor.LastMask));
+
+    const char* p = first;
+    while (static_cast<size_t>(last - p) >= 16 + anchor.Distance) {
+        const __m128i A = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), FirstMask);
+        const __m128i B = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + anchor.Distance)), LastMask);
+        const unsigned int Mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(A, First),
+                                                                  _mm_cmpeq_epi8(B, Last)));
+        if (Mask != 0)
+            return p + lowestBit(Mask);
+        p += 16;
+    }
+    return findScalar(p, last, anchor);
+}
+
+//------------------------------------------------------------------------------
+
+TARGET_AVX2
+static const char* findAvx2(const char* first, const char* last, const TAnchor& anchor)
+{
+    const __m256i First     = _mm256_set1_epi8(static_cast<char>(anchor.First));
+    const __m256i FirstMask = _mm256_set1_epi8(static_cast<char>(anchor.FirstMask));
+    const __m256i Last      = _mm256_set1_epi8(static_cast<char>(anchor.Last));
+    const __m256i LastMask  = _mm256_set1_epi8(static_cast<char>(anchor.LastMask));
+
+    const char* p = first;
+    while (static_cast<size_t>(last - p) >= 32 + anchor.Distance) {
+        const __m256i A = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), FirstMask);
+        const __m256i B = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + anchor.Distance)), LastMask);
+        const unsigned int Mask = static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(A, First),
+                                                  _mm256_cmpeq_epi8(B, Last))));
+        if (Mask != 0)
+            return p + lowestBit(Mask);
+        p += 32;
+    }
+    return findSse2(p, last, anchor);
+}
+
+//------------------------------------------------------------------------------
+
+static bool hasSse2()
+{
+    #if defined(__x86_64__) || defined(_M_X64)
+        return true;
+    #elif defined(_MSC_VER)
+        int Info[4];
+        __cpuid(Info, 1);
+        return (Info[3] & (1 << 26)) != 0;
+    #else
+        return __builtin_cpu_supports("sse2");
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+static bool hasAvx2()
+{
+    #if defined(_MSC_VER)
+        int Info[4];
+        __cpuid(Info, 0);
+        if (Info[0] < 7)
+            return false;
+        __cpuid(Info, 1);
+        const bool OsXSave = (Info[2] & (1 << 27)) != 0;
+        const bool Avx = (Info[2] & (1 << 28)) != 0;
+        if (!OsXSave || !Avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+    #else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    #endif
+}
+
+#endif // SEARCH_KERNEL_X86
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+const char* TSearchKernel::m_Name = "scalar";
+TSearchKernel::TFindFunc TSearchKernel::m_Find = TSearchKernel::select();
+
+//------------------------------------------------------------------------------
+
+TSearchKernel::TFindFunc TSearchKernel::select()
+{
+    #ifdef SEARCH_KERNEL_X86
+        if (hasAvx2()) {
+            m_Name = "AVX2";
+            return findAvx2;
+        }
+        if (hasSse2()) {
+            m_Name = "SSE2";
+            return findSse2;
+        }
+    #endif
+    m_Name = "scalar";
+    return findScalar;
+}
+
+//------------------------------------------------------------------------------
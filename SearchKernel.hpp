@@ -0,0 +1,81 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_SEARCHKERNEL__
+#define __QTBINPATCHER2_SEARCHKERNEL__
+
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Two bytes of searched string: the first one and the byte at given distance.
+// Masks are OR'ed to data bytes before comparison (0x20 for letters gives
+// case-insensitive comparison).
+
+struct TAnchor
+{
+    unsigned char First;
+    unsigned char FirstMask;
+    unsigned char Last;
+    unsigned char LastMask;
+    size_t        Distance;
+
+    TAnchor();
+    TAnchor(const char* str, size_t length, bool caseInsensitive);
+};
+
+//------------------------------------------------------------------------------
+// Fast searching for candidate positions of anchor. Implementation (SSE2, AVX2
+// or scalar) is selected once at runtime according to CPU capabilities.
+
+class TSearchKernel
+{
+    private :
+        typedef const char* (*TFindFunc)(const char* first, const char* last, const TAnchor& anchor);
+
+        static TFindFunc   m_Find;
+        static const char* m_Name;
+
+        static TFindFunc select();
+
+    public :
+        // Returns first position p in [first, last) where both bytes of anchor
+        // are matched (p + anchor.Distance < last) or last if not found.
+        static inline const char* find(const char* first, const char* last, const TAnchor& anchor)
+            { return first < last ? m_Find(first, last, anchor) : last; }
+        static inline const char* name()
+            { return m_Name; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_SEARCHKERNEL__
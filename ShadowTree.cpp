@@ -0,0 +1,341 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "ShadowTree.hpp"
+
+#include <stdio.h>
+#include <errno.h>
+
+#if defined(OS_LINUX)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <limits.h>
+#endif
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+#if defined(OS_LINUX) && !defined(RENAME_EXCHANGE)
+    #define RENAME_EXCHANGE (1 << 1)
+#endif
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char ShadowDirSuffix[] = ".qtbpshadow";
+
+//------------------------------------------------------------------------------
+
+TShadowTree::TShadowTree(const string& dir)
+    : m_Dir(dir),
+      m_ShadowDir(dir + ShadowDirSuffix),
+      m_Created(false),
+      m_Published(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TShadowTree::~TShadowTree()
+{
+    if (m_Created && !m_Published) {
+        LOG_V("\nRemoving shadow tree \"%s\".\n", m_ShadowDir.c_str());
+        removeDir(m_ShadowDir);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Removing of directory with all its content. Symbolic links are removed,
+// not followed.
+
+bool TShadowTree::removeDir(const string& dir)
+{
+    #if defined(OS_WINDOWS)
+        LOG_E("Removing of directory tree is not supported.\n");
+        return false;
+    #elif defined(OS_LINUX)
+        DIR* pDir = opendir(dir.c_str());
+        if (pDir == NULL) {
+            LOG_E("Error opening directory \"%s\". Error %i.\n", dir.c_str(), errno);
+            return false;
+        }
+
+        bool Result = true;
+        struct dirent* pEntry;
+        while ((pEntry = readdir(pDir)) != NULL) {
+            const string Name = pEntry->d_name;
+            if (Name == "." || Name == "..")
+                continue;
+            const string FileName = dir + '/' + Name;
+            struct stat Stat;
+            if (lstat(FileName.c_str(), &Stat) == 0 && S_ISDIR(Stat.st_mode)) {
+                if (!removeDir(FileName))
+                    Result = false;
+            }
+            else if (unlink(FileName.c_str()) != 0) {
+                LOG_E("Error removing file \"%s\". Error %i.\n", FileName.c_str(), errno);
+                Result = false;
+            }
+        }
+        closedir(pDir);
+
+        if (Result && rmdir(dir.c_str()) != 0) {
+            LOG_E("Error removing directory \"%s\". Error %i.\n", dir.c_str(), errno);
+            Result = false;
+        }
+        return Result;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Creating of shadow directory for directory. Subdirectories get the same
+// permissions; files are linked or copied. If file can't be linked (link
+// count limit or protected hard links), it is copied; symbolic link is
+// created anew.
+
+bool TShadowTree::createDir(const string& dir, const string& shadowDir,
+                            const TStringSet& copied, const TStringSet& excluded)
+{
+    #if defined(OS_WINDOWS)
+        LOG_E("Shadow tree is not supported.\n");
+        return false;
+    #elif defined(OS_LINUX)
+        struct stat Stat;
+        if (lstat(dir.c_str(), &Stat) != 0 || mkdir(shadowDir.c_str(), S_IRWXU) != 0) {
+            LOG_E("Error creating directory \"%s\". Error %i.\n", shadowDir.c_str(), errno);
+            return false;
+        }
+        if (chown(shadowDir.c_str(), Stat.st_uid, Stat.st_gid) != 0)
+            LOG_V("Can't change owner of directory \"%s\". Error %i.\n", shadowDir.c_str(), errno);
+
+        DIR* pDir = opendir(dir.c_str());
+        if (pDir == NULL) {
+            LOG_E("Error opening directory \"%s\". Error %i.\n", dir.c_str(), errno);
+            return false;
+        }
+
+        bool Result = true;
+        struct dirent* pEntry;
+        while (Result && (pEntry = readdir(pDir)) != NULL) {
+            const string Name = pEntry->d_name;
+            if (Name == "." || Name == "..")
+                continue;
+            const string FileName = dir + '/' + Name;
+            const string ShadowFileName = shadowDir + '/' + Name;
+            if (excluded.count(FileName) != 0) {
+                LOG_V("Skipping file \"%s\" in shadow tree.\n", FileName.c_str());
+                continue;
+            }
+
+            struct stat FileStat;
+            if (lstat(FileName.c_str(), &FileStat) != 0) {
+                LOG_E("Error getting info of file \"%s\". Error %i.\n", FileName.c_str(), errno);
+                Result = false;
+            }
+            else if (S_ISDIR(FileStat.st_mode)) {
+                Result = createDir(FileName, ShadowFileName, copied, excluded);
+            }
+            else if (copied.count(FileName) != 0) {
+                Result = Functions::copyFile(FileName, ShadowFileName);
+            }
+            else if (link(FileName.c_str(), ShadowFileName.c_str()) != 0) {
+                if (S_ISLNK(FileStat.st_mode)) {
+                    char Target[PATH_MAX];
+                    const ssize_t Length = readlink(FileName.c_str(), Target, sizeof(Target) - 1);
+                    Result = Length >= 0 && symlink(string(Target, Length).c_str(), ShadowFileName.c_str()) == 0;
+                }
+                else {
+                    Result = S_ISREG(FileStat.st_mode) && Functions::copyFile(FileName, ShadowFileName);
+                }
+                if (!Result)
+                    LOG_E("Error linking file \"%s\" to \"%s\". Error %i.\n",
+                          FileName.c_str(), ShadowFileName.c_str(), errno);
+            }
+        }
+        closedir(pDir);
+
+        // Permissions are set at last: directory may be read-only.
+        if (Result && chmod(shadowDir.c_str(), Stat.st_mode & 07777) != 0) {
+            LOG_E("Error changing permissions of directory \"%s\". Error %i.\n", shadowDir.c_str(), errno);
+            Result = false;
+        }
+        return Result;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Creating of shadow tree. Shadow tree, which was left by killed process, is
+// removed before.
+
+bool TShadowTree::create(const TStringSet& copied, const TStringSet& excluded)
+{
+    LOG_V("\nCreating shadow tree \"%s\".\n", m_ShadowDir.c_str());
+
+    if (Functions::isFileExists(m_ShadowDir)) {
+        LOG_V("Removing old shadow tree.\n");
+        if (!removeDir(m_ShadowDir))
+            return false;
+    }
+
+    m_Created = true;
+    return createDir(m_Dir, m_ShadowDir, copied, excluded);
+}
+
+//------------------------------------------------------------------------------
+// Getting name of file in the tree without symbolic links (target of link).
+// If file can't be resolved or the link leads out of the tree, the name is
+// returned as is; then the link is replaced by copy of target.
+
+string TShadowTree::realFileName(const string& fileName) const
+{
+    #if defined(OS_WINDOWS)
+        return fileName;
+    #elif defined(OS_LINUX)
+        char RealDir[PATH_MAX], RealFile[PATH_MAX];
+        if (realpath(m_Dir.c_str(), RealDir) == NULL || realpath(fileName.c_str(), RealFile) == NULL)
+            return fileName;
+
+        const string Dir = string(RealDir) + '/';
+        const string File = RealFile;
+        if (File.compare(0, Dir.length(), Dir) != 0) {
+            LOG_V("File \"%s\" leads out of directory \"%s\". It will be copied.\n",
+                  fileName.c_str(), m_Dir.c_str());
+            return fileName;
+        }
+        return m_Dir + '/' + File.substr(Dir.length());
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+string TShadowTree::shadowFileName(const string& fileName) const
+{
+    if (fileName.compare(0, m_Dir.length(), m_Dir) == 0)
+        return m_ShadowDir + fileName.substr(m_Dir.length());
+    return fileName;
+}
+
+//------------------------------------------------------------------------------
+// Checking that file of shadow tree is a copy, not a link to file of the
+// tree, so it can be changed.
+
+bool TShadowTree::isCopy(const string& shadowFileName) const
+{
+    #if defined(OS_WINDOWS)
+        return false;
+    #elif defined(OS_LINUX)
+        struct stat Stat;
+        if (lstat(shadowFileName.c_str(), &Stat) != 0 || !S_ISREG(Stat.st_mode) || Stat.st_nlink != 1) {
+            LOG_E("File \"%s\" in shadow tree is not a copy.\n", shadowFileName.c_str());
+            return false;
+        }
+        return true;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Exchanging of the tree and shadow tree. If file system can't exchange
+// directories atomically, they are exchanged by three renames.
+
+bool TShadowTree::exchange()
+{
+    #if defined(OS_WINDOWS)
+        LOG_E("Shadow tree is not supported.\n");
+        return false;
+    #elif defined(OS_LINUX)
+        #if defined(SYS_renameat2)
+            if (syscall(SYS_renameat2, AT_FDCWD, m_ShadowDir.c_str(), AT_FDCWD, m_Dir.c_str(), RENAME_EXCHANGE) == 0)
+                return true;
+            if (errno != ENOSYS && errno != EINVAL) {
+                LOG_E("Error exchanging directories \"%s\" and \"%s\". Error %i.\n",
+                      m_Dir.c_str(), m_ShadowDir.c_str(), errno);
+                return false;
+            }
+        #endif
+
+        LOG_V("Directories can't be exchanged atomically. Renaming them.\n");
+        const string TmpDir = m_Dir + ".qtbptmp";
+        if (rename(m_Dir.c_str(), TmpDir.c_str()) != 0) {
+            LOG_E("Error renaming directory \"%s\". Error %i.\n", m_Dir.c_str(), errno);
+            return false;
+        }
+        if (rename(m_ShadowDir.c_str(), m_Dir.c_str()) != 0) {
+            LOG_E("Error renaming directory \"%s\". Error %i.\n", m_ShadowDir.c_str(), errno);
+            rename(TmpDir.c_str(), m_Dir.c_str());
+            return false;
+        }
+        if (rename(TmpDir.c_str(), m_ShadowDir.c_str()) != 0) {
+            LOG_E("Error renaming directory \"%s\". Error %i.\n", TmpDir.c_str(), errno);
+            return false;
+        }
+        return true;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+// Publishing of shadow tree. The old tree is renamed to oldDir or removed if
+// oldDir is empty.
+
+bool TShadowTree::publish(const string& oldDir)
+{
+    LOG_V("\nPublishing shadow tree \"%s\".\n", m_ShadowDir.c_str());
+    if (!exchange())
+        return false;
+    m_Published = true;
+
+    if (!oldDir.empty()) {
+        LOG_V("Old tree is kept as \"%s\".\n", oldDir.c_str());
+        return Functions::renameFile(m_ShadowDir, oldDir);
+    }
+    LOG_V("Removing old tree.\n");
+    return removeDir(m_ShadowDir);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,81 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_SHADOWTREE__
+#define __QTBINPATCHER2_SHADOWTREE__
+
+//------------------------------------------------------------------------------
+
+#include "CommonTypes.hpp"
+
+//------------------------------------------------------------------------------
+// Shadow copy of directory tree. Shadow tree is created near the tree: its
+// files are hard links to files of the tree, except files, which will be
+// changed (they are copied), and excluded files. After changing shadow tree
+// is exchanged with the tree by one rename, so readers see either the old
+// or the new tree. Then the old tree is removed or kept under other name.
+// Shadow tree, which was not published, is removed by destructor. Symbolic
+// links are kept as links, so files to be changed must be given by names of
+// their targets (see realFileName()).
+
+class TShadowTree
+{
+    private :
+        std::string m_Dir;
+        std::string m_ShadowDir;
+        bool        m_Created;
+        bool        m_Published;
+
+        TShadowTree(const TShadowTree&);
+        TShadowTree& operator=(const TShadowTree&);
+
+        static bool removeDir(const std::string& dir);
+        bool createDir(const std::string& dir, const std::string& shadowDir,
+                       const TStringSet& copied, const TStringSet& excluded);
+        bool exchange();
+
+    public :
+        explicit TShadowTree(const std::string& dir);
+        ~TShadowTree();
+
+        bool create(const TStringSet& copied, const TStringSet& excluded);
+        std::string realFileName(const std::string& fileName) const;
+        std::string shadowFileName(const std::string& fileName) const;
+        bool isCopy(const std::string& shadowFileName) const;
+        bool publish(const std::string& oldDir);
+
+        inline const std::string& shadowDir() const
+            { return m_ShadowDir; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_SHADOWTREE__
@@ -0,0 +1,189 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "SiteIndex.hpp"
+
+#include <errno.h>
+
+#include "Logger.hpp"
+#include "Functions.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char   IndexFileSuffix[] = ".qtbpidx";
+static const char   IndexSignature[]  = "QtBinPatcher site index 2";
+static const size_t HeadSize          = 4096;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TSiteIndex::TSlot::TSlot(size_t offset, size_t length)
+    : Offset(offset), Length(length)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TSiteIndex::TSiteIndex(const string& fileName)
+    : m_FileName(fileName),
+      m_IndexFileName(fileName + IndexFileSuffix),
+      m_FileSize(0),
+      m_FileTime(0),
+      m_Hash(0)
+{
+}
+
+//------------------------------------------------------------------------------
+// Hash of file head and contents of all slots. Head changes when file is
+// rebuilt; slots keep values written by the last patching.
+
+bool TSiteIndex::calcHash(FILE* file, uint64_t* pHash) const
+{
+    vector<char> Buf(HeadSize);
+    rewind(file);
+    const size_t HeadLength = fread(Buf.data(), 1, Buf.size(), file);
+    uint64_t Hash = Functions::hash(Buf.data(), HeadLength);
+
+    for (TSlots::const_iterator Iter = m_Slots.begin(); Iter != m_Slots.end(); ++Iter) {
+        Buf.resize(Iter->Length);
+        if (!Functions::seekFile(file, Iter->Offset) ||
+            fread(Buf.data(), Iter->Length, 1, file) != 1)
+            return false;
+        Hash = Functions::hash(Buf.data(), Buf.size(), Hash);
+    }
+
+    *pHash = Hash;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Loading index. Returns false if there is no index or it is outdated (file
+// size or modification time were changed).
+
+bool TSiteIndex::load()
+{
+    m_Slots.clear();
+
+    FILE* File = fopen(m_IndexFileName.c_str(), "rb");
+    if (File == NULL)
+        return false;
+
+    char Signature[sizeof(IndexSignature)];
+    unsigned long long FileSize = 0, FileTime = 0, Hash = 0, Offset = 0, Length = 0;
+    bool Result = fgets(Signature, sizeof(Signature), File) != NULL &&
+                  string(Signature) == IndexSignature &&
+                  fscanf(File, " size %llu time %llu hash %llx", &FileSize, &FileTime, &Hash) == 3;
+    while (Result && fscanf(File, " slot %llu %llu", &Offset, &Length) == 2)
+        m_Slots.push_back(TSlot(static_cast<size_t>(Offset), static_cast<size_t>(Length)));
+    if (Result)
+        Result = feof(File) != 0;
+    fclose(File);
+
+    if (!Result) {
+        LOG_V("  Site index \"%s\" is broken.\n", m_IndexFileName.c_str());
+        m_Slots.clear();
+        return false;
+    }
+
+    m_FileSize = FileSize;
+    m_FileTime = FileTime;
+    m_Hash = Hash;
+
+    uint64_t CurFileSize = 0, CurFileTime = 0;
+    if (!Functions::getFileInfo(m_FileName, &CurFileSize, &CurFileTime) ||
+        CurFileSize != m_FileSize || CurFileTime != m_FileTime)
+    {
+        LOG_V("  Site index \"%s\" is outdated.\n", m_IndexFileName.c_str());
+        m_Slots.clear();
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Checking hash of opened file against loaded index.
+
+bool TSiteIndex::check(FILE* file) const
+{
+    uint64_t Hash = 0;
+    if (!calcHash(file, &Hash) || Hash != m_Hash) {
+        LOG_V("  Site index \"%s\" doesn't match file content.\n", m_IndexFileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Saving index for current state of the file. Must be called after all
+// changes of the file are written and the file is closed. Index is only an
+// optimization, so errors are not fatal and are logged in verbose mode.
+
+bool TSiteIndex::save()
+{
+    FILE* File = fopen(m_FileName.c_str(), "rb");
+    bool Result = File != NULL && calcHash(File, &m_Hash);
+    if (File != NULL)
+        fclose(File);
+    if (Result)
+        Result = Functions::getFileInfo(m_FileName, &m_FileSize, &m_FileTime);
+
+    if (Result) {
+        File = fopen(m_IndexFileName.c_str(), "wb");
+        Result = File != NULL;
+    }
+    if (Result) {
+        fprintf(File, "%s\nsize %llu\ntime %llu\nhash %016llx\n", IndexSignature,
+                static_cast<unsigned long long>(m_FileSize),
+                static_cast<unsigned long long>(m_FileTime),
+                static_cast<unsigned long long>(m_Hash));
+        for (TSlots::const_iterator Iter = m_Slots.begin(); Iter != m_Slots.end(); ++Iter)
+            fprintf(File, "slot %llu %llu\n",
+                    static_cast<unsigned long long>(Iter->Offset),
+                    static_cast<unsigned long long>(Iter->Length));
+        Result = ferror(File) == 0;
+        if (fclose(File) != 0)
+            Result = false;
+    }
+
+    if (!Result) {
+        LOG_V("  Can't save site index \"%s\". Error %i.\n", m_IndexFileName.c_str(), errno);
+        remove(m_IndexFileName.c_str());
+    }
+    return Result;
+}
+
+//------------------------------------------------------------------------------
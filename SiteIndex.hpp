@@ -0,0 +1,85 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_SITEINDEX__
+#define __QTBINPATCHER2_SITEINDEX__
+
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "CommonTypes.hpp"
+
+//------------------------------------------------------------------------------
+// Index of slots found in binary file. It is stored next to the file (in
+// "<file>.qtbpidx") and is valid while size, modification time and hash of
+// file head and slots are the same as when index was saved. So repeated
+// patching of the same file writes slots without searching.
+
+class TSiteIndex
+{
+    public :
+        struct TSlot {
+            size_t Offset;
+            size_t Length;
+
+            TSlot(size_t offset, size_t length);
+        };
+        typedef std::vector<TSlot> TSlots;
+
+    private :
+        std::string m_FileName;
+        std::string m_IndexFileName;
+        uint64_t    m_FileSize;
+        uint64_t    m_FileTime;
+        uint64_t    m_Hash;
+        TSlots      m_Slots;
+
+        bool calcHash(FILE* file, uint64_t* pHash) const;
+
+    public :
+        explicit TSiteIndex(const std::string& fileName);
+
+        bool load();
+        bool check(FILE* file) const;
+        bool save();
+
+        inline const TSlots& slots() const
+            { return m_Slots; }
+        inline void setSlots(const TSlots& slots)
+            { m_Slots = slots; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_SITEINDEX__
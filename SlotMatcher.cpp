@@ -0,0 +1,353 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "SlotMatcher.hpp"
+
+#include <string.h>
+#include <assert.h>
+
+#include "Logger.hpp"
+#include "Threads.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+static const char   KeyPrefix[]     = "qt_";
+static const size_t KeyPrefixLength = sizeof(KeyPrefix) - 1;
+static const char   KeySuffix[]     = "path=";
+static const size_t KeySuffixLength = sizeof(KeySuffix) - 1;
+static const size_t KeyCodeOffset   = KeyPrefixLength;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TSlotMatcher::TSite::TSite(size_t offset, size_t value)
+    : Offset(offset), Value(value)
+{
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+const size_t TSlotMatcher::KeyLength;
+const size_t TSlotMatcher::MaxSlotLength;
+const size_t TSlotMatcher::ChunkSize;
+const size_t TSlotMatcher::HashSize;
+const unsigned char TSlotMatcher::EmptyCell;
+
+//------------------------------------------------------------------------------
+// Four characters between "qt_" and "path=" packed into one integer.
+
+unsigned int TSlotMatcher::code(const char* key)
+{
+    const unsigned char* const p = reinterpret_cast<const unsigned char*>(key + KeyCodeOffset);
+    return  static_cast<unsigned int>(p[0])        |
+           (static_cast<unsigned int>(p[1]) << 8)  |
+           (static_cast<unsigned int>(p[2]) << 16) |
+           (static_cast<unsigned int>(p[3]) << 24);
+}
+
+//------------------------------------------------------------------------------
+
+size_t TSlotMatcher::hash(unsigned int code)
+{
+    return ((code * 2654435761u) >> 26) & (HashSize - 1);
+}
+
+//------------------------------------------------------------------------------
+// Returns index of value for key or npos if key is unknown.
+
+size_t TSlotMatcher::lookup(const char* key) const
+{
+    const unsigned int Code = code(key);
+    for (size_t i = hash(Code); m_Cells[i] != EmptyCell; i = (i + 1) & (HashSize - 1))
+        if (m_Codes[i] == Code)
+            return memcmp(key + KeyLength - KeySuffixLength, KeySuffix, KeySuffixLength) == 0
+                   ? m_Cells[i] : string::npos;
+    return string::npos;
+}
+
+//------------------------------------------------------------------------------
+
+TSlotMatcher::TSlotMatcher()
+    : m_Anchor(KeyPrefix, KeyPrefixLength, false)
+{
+    memset(m_Codes, 0, sizeof(m_Codes));
+    memset(m_Cells, EmptyCell, sizeof(m_Cells));
+}
+
+//------------------------------------------------------------------------------
+
+bool TSlotMatcher::init(const TStringMap& values)
+{
+    m_Values.clear();
+    memset(m_Codes, 0, sizeof(m_Codes));
+    memset(m_Cells, EmptyCell, sizeof(m_Cells));
+
+    for (TStringMap::const_iterator Iter = values.begin(); Iter != values.end(); ++Iter)
+    {
+        const string& Key = Iter->first;
+        if (Key.length() != KeyLength ||
+            Key.compare(0, KeyPrefixLength, KeyPrefix) != 0 ||
+            Key.compare(KeyLength - KeySuffixLength, KeySuffixLength, KeySuffix) != 0)
+        {
+            LOG_E("Unsupported binary patch key \"%s\".\n", Key.c_str());
+            return false;
+        }
+        assert(m_Values.size() < HashSize / 2);
+
+        const unsigned int Code = code(Key.c_str());
+        size_t i = hash(Code);
+        while (m_Cells[i] != EmptyCell)
+            i = (i + 1) & (HashSize - 1);
+        m_Codes[i] = Code;
+        m_Cells[i] = static_cast<unsigned char>(m_Values.size());
+        m_Values.push_back(Iter->second);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Checking if ranges of data contain at least one known key.
+
+bool TSlotMatcher::contains(const char* data, const TFileRanges& ranges) const
+{
+    if (m_Values.empty())
+        return false;
+
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Iter != ranges.end(); ++Iter) {
+        if (Iter->Size < KeyLength)
+            continue;
+        const char* const End = data + Iter->Offset + Iter->Size - KeyLength + KeyPrefixLength;
+        for (const char* p = data + Iter->Offset; (p = TSearchKernel::find(p, End, m_Anchor)) != End; ++p)
+            if (p[1] == KeyPrefix[1] && lookup(p) != string::npos)
+                return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+// Searching for all known slots in range of data. After found slot searching
+// continues behind the new value (as it will be written into the slot).
+// Offsets of sites are counted from the beginning of data.
+
+size_t TSlotMatcher::find(const char* data, const TFileRange& range, TSites* pSites) const
+{
+    const size_t StartCount = pSites->size();
+    if (m_Values.empty() || range.Size < KeyLength)
+        return 0;
+
+    const char* const RangeEnd = data + range.Offset + range.Size;
+    const char* const End = RangeEnd - KeyLength + KeyPrefixLength;
+    const char* p = data + range.Offset;
+    while ((p = TSearchKernel::find(p, End, m_Anchor)) != End)
+    {
+        if (p[1] == KeyPrefix[1]) {
+            const size_t Value = lookup(p);
+            if (Value != string::npos) {
+                const size_t Offset = p - data;
+                // Value with terminating zero must fit into the range.
+                if (static_cast<size_t>(RangeEnd - p) > m_Values[Value].length()) {
+                    pSites->push_back(TSite(Offset, Value));
+                    p += m_Values[Value].length();
+                    continue;
+                }
+            }
+        }
+        ++p;
+    }
+
+    return pSites->size() - StartCount;
+}
+
+//------------------------------------------------------------------------------
+
+size_t TSlotMatcher::find(const char* data, const TFileRanges& ranges, TSites* pSites) const
+{
+    size_t Count = 0;
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Iter != ranges.end(); ++Iter)
+        Count += find(data, *Iter, pSites);
+    return Count;
+}
+
+//------------------------------------------------------------------------------
+// Searching for all known keys starting in [from, to) of range (offsets from
+// the beginning of data). Keys may end behind "to", so neighbour parts of
+// range overlap by KeyLength - 1 bytes. Slots are not skipped here: keys
+// inside new values are dropped later by selectSites().
+
+void TSlotMatcher::findKeys(const char* data, const TFileRange& range, size_t from, size_t to, TSites* pKeys) const
+{
+    if (m_Values.empty() || range.Size < KeyLength)
+        return;
+
+    const size_t LastStart = range.Offset + range.Size - KeyLength;
+    if (to > LastStart + 1)
+        to = LastStart + 1;
+    if (from >= to)
+        return;
+
+    const char* const End = data + to + KeyPrefixLength - 1;
+    const char* p = data + from;
+    while ((p = TSearchKernel::find(p, End, m_Anchor)) != End)
+    {
+        if (p[1] == KeyPrefix[1]) {
+            const size_t Value = lookup(p);
+            if (Value != string::npos)
+                pKeys->push_back(TSite(p - data, Value));
+        }
+        ++p;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Selecting sites from all keys of range in the same way as find() does.
+
+size_t TSlotMatcher::selectSites(const TFileRange& range, const TSites& keys, TSites* pSites) const
+{
+    const size_t StartCount = pSites->size();
+    const size_t RangeEnd = range.Offset + range.Size;
+    size_t Next = range.Offset;
+    for (TSites::const_iterator Iter = keys.begin(); Iter != keys.end(); ++Iter) {
+        const size_t Length = m_Values[Iter->Value].length();
+        if (Iter->Offset >= Next && RangeEnd - Iter->Offset > Length) {
+            pSites->push_back(*Iter);
+            Next = Iter->Offset + Length;
+        }
+    }
+    return pSites->size() - StartCount;
+}
+
+//------------------------------------------------------------------------------
+// Length of slot at offset: key with value, terminating zero and zero
+// padding behind it, but not behind end. Qt declares slots as arrays of
+// 512 + 12 characters, so slot is never longer than MaxSlotLength.
+
+size_t TSlotMatcher::slotLength(const char* data, size_t offset, size_t end)
+{
+    if (end - offset > MaxSlotLength)
+        end = offset + MaxSlotLength;
+    const char* const End = data + end;
+    const char* p = static_cast<const char*>(memchr(data + offset, '\0', end - offset));
+    if (p == NULL)
+        return end - offset;
+    while (p != End && *p == '\0')
+        ++p;
+    return p - (data + offset);
+}
+
+//------------------------------------------------------------------------------
+// Job of searching for keys in chunks of ranges.
+
+struct TChunk {
+    size_t Range;
+    size_t From;
+    size_t To;
+    TSlotMatcher::TSites Keys;
+};
+
+//------------------------------------------------------------------------------
+
+class TScanJob : public TThreadPool::TJob
+{
+    private :
+        const TSlotMatcher& m_Matcher;
+        const char*         m_pData;
+        const TFileRanges&  m_Ranges;
+        vector<TChunk>&     m_Chunks;
+
+    public :
+        TScanJob(const TSlotMatcher& matcher, const char* data, const TFileRanges& ranges, vector<TChunk>& chunks);
+        virtual bool run(size_t index);
+};
+
+//------------------------------------------------------------------------------
+
+TScanJob::TScanJob(const TSlotMatcher& matcher, const char* data, const TFileRanges& ranges, vector<TChunk>& chunks)
+    : m_Matcher(matcher),
+      m_pData(data),
+      m_Ranges(ranges),
+      m_Chunks(chunks)
+{
+}
+
+//------------------------------------------------------------------------------
+
+bool TScanJob::run(size_t index)
+{
+    TChunk& Chunk = m_Chunks[index];
+    m_Matcher.findKeys(m_pData, m_Ranges[Chunk.Range], Chunk.From, Chunk.To, &Chunk.Keys);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Searching in several threads. Ranges are split into chunks of ChunkSize
+// bytes, keys found in chunks are merged in order of offsets and sites are
+// selected from them. Result is the same as of single-threaded find().
+
+size_t TSlotMatcher::find(const char* data, const TFileRanges& ranges, TSites* pSites, unsigned int threadCount) const
+{
+    size_t Size = 0;
+    for (TFileRanges::const_iterator Iter = ranges.begin(); Iter != ranges.end(); ++Iter)
+        Size += Iter->Size;
+    if (threadCount <= 1 || Size < 2 * ChunkSize || m_Values.empty())
+        return find(data, ranges, pSites);
+
+    vector<TChunk> Chunks;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        const size_t End = ranges[i].Offset + ranges[i].Size;
+        for (size_t From = ranges[i].Offset; From < End; From += ChunkSize) {
+            Chunks.push_back(TChunk());
+            Chunks.back().Range = i;
+            Chunks.back().From = From;
+            Chunks.back().To = End - From > ChunkSize ? From + ChunkSize : End;
+        }
+    }
+
+    TScanJob Job(*this, data, ranges, Chunks);
+    TThreadPool::run(&Job, Chunks.size(), threadCount);
+
+    size_t Count = 0;
+    TSites Keys;
+    for (size_t i = 0; i < Chunks.size(); ++i) {
+        Keys.insert(Keys.end(), Chunks[i].Keys.begin(), Chunks[i].Keys.end());
+        if (i + 1 == Chunks.size() || Chunks[i + 1].Range != Chunks[i].Range) {
+            Count += selectSites(ranges[Chunks[i].Range], Keys, pSites);
+            Keys.clear();
+        }
+    }
+    return Count;
+}
+
+//------------------------------------------------------------------------------
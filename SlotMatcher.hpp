@@ -0,0 +1,99 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_SLOTMATCHER__
+#define __QTBINPATCHER2_SLOTMATCHER__
+
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include "CommonTypes.hpp"
+#include "SearchKernel.hpp"
+
+//------------------------------------------------------------------------------
+// Searching for "qt_????path=" slots in binary files in one pass. All keys
+// share the prefix "qt_" and differ only in four characters, so the matcher
+// looks for the prefix with search kernel and checks the rest of key with
+// small hash table.
+
+class TSlotMatcher
+{
+    public :
+        struct TSite {
+            size_t Offset;
+            size_t Value;
+
+            TSite(size_t offset, size_t value);
+        };
+        typedef std::vector<TSite> TSites;
+
+        static const size_t KeyLength = 12;
+        static const size_t MaxSlotLength = 512 + KeyLength;
+        static const size_t ChunkSize = 4 * 1024 * 1024;
+
+    private :
+        static const size_t HashSize = 64;
+        static const unsigned char EmptyCell = 0xFF;
+
+        std::vector<std::string> m_Values;
+        TAnchor       m_Anchor;
+        unsigned int  m_Codes[HashSize];
+        unsigned char m_Cells[HashSize];
+
+        static unsigned int code(const char* key);
+        static size_t hash(unsigned int code);
+
+    public :
+        TSlotMatcher();
+
+        bool init(const TStringMap& values);
+        size_t lookup(const char* key) const;
+        bool contains(const char* data, const TFileRanges& ranges) const;
+        size_t find(const char* data, const TFileRange& range, TSites* pSites) const;
+        size_t find(const char* data, const TFileRanges& ranges, TSites* pSites) const;
+        size_t find(const char* data, const TFileRanges& ranges, TSites* pSites, unsigned int threadCount) const;
+        void findKeys(const char* data, const TFileRange& range, size_t from, size_t to, TSites* pKeys) const;
+        size_t selectSites(const TFileRange& range, const TSites& keys, TSites* pSites) const;
+        static size_t slotLength(const char* data, size_t offset, size_t end);
+
+        inline size_t find(const char* data, size_t size, TSites* pSites) const
+            { return find(data, TFileRange(0, size), pSites); }
+
+        inline bool isEmpty() const
+            { return m_Values.empty(); }
+        inline const std::string& value(size_t index) const
+            { return m_Values[index]; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_SLOTMATCHER__
@@ -0,0 +1,145 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "TextReplacer.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TTextReplacer::TTextReplacer()
+    : m_pKernel(NULL)
+{
+}
+
+//------------------------------------------------------------------------------
+
+TTextReplacer::~TTextReplacer()
+{
+    delete m_pKernel;
+}
+
+//------------------------------------------------------------------------------
+
+template <class TCase>
+TReplaceKernel* TTextReplacer::createKernel() const
+{
+    bool SameLength = true;
+    for (size_t i = 0; i < m_From.size(); ++i)
+        if (m_From[i].length() != m_To[i].length()) {
+            SameLength = false;
+            break;
+        }
+
+    if (m_From.size() == 1) {
+        if (SameLength)
+            return new TReplaceKernelImpl<TCase, TSingleSearch, TInPlaceMode>(m_From, m_To);
+        return new TReplaceKernelImpl<TCase, TSingleSearch, TResizeMode>(m_From, m_To);
+    }
+
+    if (m_From.size() <= TSmallSearch<TCase>::MaxPatterns && commonPrefixLength<TCase>(m_From) > 0) {
+        if (SameLength)
+            return new TReplaceKernelImpl<TCase, TSmallSearch, TInPlaceMode>(m_From, m_To);
+        return new TReplaceKernelImpl<TCase, TSmallSearch, TResizeMode>(m_From, m_To);
+    }
+
+    if (SameLength)
+        return new TReplaceKernelImpl<TCase, TAutomatonSearch, TInPlaceMode>(m_From, m_To);
+    return new TReplaceKernelImpl<TCase, TAutomatonSearch, TResizeMode>(m_From, m_To);
+}
+
+//------------------------------------------------------------------------------
+
+void TTextReplacer::init(const TStringMap& values, bool caseInsensitive)
+{
+    delete m_pKernel;
+    m_pKernel = NULL;
+    m_From.clear();
+    m_To.clear();
+
+    for (TStringMap::const_iterator Iter = values.begin(); Iter != values.end(); ++Iter)
+        if (!Iter->first.empty()) {
+            m_From.push_back(Iter->first);
+            m_To.push_back(Iter->second);
+        }
+
+    if (!m_From.empty()) {
+        if (caseInsensitive)
+            m_pKernel = createKernel<TCaseInsensitive>();
+        else
+            m_pKernel = createKernel<TCaseSensitive>();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+size_t TTextReplacer::find(const char* data, size_t size, TTextMatches* pMatches) const
+{
+    const size_t StartCount = pMatches->size();
+    if (m_pKernel != NULL)
+        m_pKernel->find(data, size, pMatches);
+    return pMatches->size() - StartCount;
+}
+
+//------------------------------------------------------------------------------
+// Replacing matches found by find() in the same buffer.
+
+void TTextReplacer::apply(const TTextMatches& matches, vector<char>* pBuf) const
+{
+    if (m_pKernel != NULL && !matches.empty())
+        m_pKernel->apply(matches, pBuf);
+}
+
+//------------------------------------------------------------------------------
+// Returns true if replacements of all matches have the same length as
+// patterns, so size of data will not change.
+
+bool TTextReplacer::isSameLength(const TTextMatches& matches) const
+{
+    for (TTextMatches::const_iterator Iter = matches.begin(); Iter != matches.end(); ++Iter)
+        if (m_From[Iter->Pattern].length() != m_To[Iter->Pattern].length())
+            return false;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+string TTextReplacer::kernelName() const
+{
+    if (m_pKernel == NULL)
+        return "none";
+    return m_pKernel->name();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,80 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_TEXTREPLACER__
+#define __QTBINPATCHER2_TEXTREPLACER__
+
+//------------------------------------------------------------------------------
+
+#include <vector>
+
+#include "CommonTypes.hpp"
+#include "ReplaceKernels.hpp"
+
+//------------------------------------------------------------------------------
+// Replacing of many substrings in one pass. From several patterns matching at
+// the same position the longest one is replaced, matches never overlap.
+// Kernel specialized for the given set of patterns is selected in init().
+
+class TTextReplacer
+{
+    private :
+        TPatterns       m_From;
+        TPatterns       m_To;
+        TReplaceKernel* m_pKernel;
+
+        TTextReplacer(const TTextReplacer&);
+        TTextReplacer& operator=(const TTextReplacer&);
+
+        template <class TCase>
+        TReplaceKernel* createKernel() const;
+
+    public :
+        TTextReplacer();
+        ~TTextReplacer();
+
+        void init(const TStringMap& values, bool caseInsensitive);
+        size_t find(const char* data, size_t size, TTextMatches* pMatches) const;
+        void apply(const TTextMatches& matches, std::vector<char>* pBuf) const;
+        bool isSameLength(const TTextMatches& matches) const;
+        std::string kernelName() const;
+
+        inline bool isEmpty() const
+            { return m_From.empty(); }
+        inline const std::string& from(size_t pattern) const
+            { return m_From[pattern]; }
+        inline const std::string& to(size_t pattern) const
+            { return m_To[pattern]; }
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_TEXTREPLACER__
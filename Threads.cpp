@@ -0,0 +1,320 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#include "Threads.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <vector>
+#if defined(OS_WINDOWS)
+    #include <windows.h>
+    #include <process.h>
+#elif defined(OS_LINUX)
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+#include "Logger.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+#if defined(_MSC_VER)
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
+
+// Set while thread does jobs of some pool.
+static THREAD_LOCAL bool InPool = false;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TMutex::TMutex()
+{
+    #if defined(OS_WINDOWS)
+        CRITICAL_SECTION* pSection = new CRITICAL_SECTION;
+        InitializeCriticalSection(pSection);
+        m_pMutex = pSection;
+    #elif defined(OS_LINUX)
+        pthread_mutex_t* pMutex = new pthread_mutex_t;
+        pthread_mutex_init(pMutex, NULL);
+        m_pMutex = pMutex;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+TMutex::~TMutex()
+{
+    #if defined(OS_WINDOWS)
+        DeleteCriticalSection(static_cast<CRITICAL_SECTION*>(m_pMutex));
+        delete static_cast<CRITICAL_SECTION*>(m_pMutex);
+    #elif defined(OS_LINUX)
+        pthread_mutex_destroy(static_cast<pthread_mutex_t*>(m_pMutex));
+        delete static_cast<pthread_mutex_t*>(m_pMutex);
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+void TMutex::lock()
+{
+    #if defined(OS_WINDOWS)
+        EnterCriticalSection(static_cast<CRITICAL_SECTION*>(m_pMutex));
+    #elif defined(OS_LINUX)
+        pthread_mutex_lock(static_cast<pthread_mutex_t*>(m_pMutex));
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+void TMutex::unlock()
+{
+    #if defined(OS_WINDOWS)
+        LeaveCriticalSection(static_cast<CRITICAL_SECTION*>(m_pMutex));
+    #elif defined(OS_LINUX)
+        pthread_mutex_unlock(static_cast<pthread_mutex_t*>(m_pMutex));
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// Windows XP has no condition variables, so on Windows waiting threads are
+// counted and woken by semaphore.
+
+TCondition::TCondition()
+{
+    #if defined(OS_WINDOWS)
+        m_pCondition = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+        m_Waiters = 0;
+    #elif defined(OS_LINUX)
+        pthread_cond_t* pCondition = new pthread_cond_t;
+        pthread_cond_init(pCondition, NULL);
+        m_pCondition = pCondition;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+TCondition::~TCondition()
+{
+    #if defined(OS_WINDOWS)
+        CloseHandle(m_pCondition);
+    #elif defined(OS_LINUX)
+        pthread_cond_destroy(static_cast<pthread_cond_t*>(m_pCondition));
+        delete static_cast<pthread_cond_t*>(m_pCondition);
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+void TCondition::wait(TMutex& mutex)
+{
+    #if defined(OS_WINDOWS)
+        ++m_Waiters;
+        mutex.unlock();
+        WaitForSingleObject(m_pCondition, INFINITE);
+        mutex.lock();
+    #elif defined(OS_LINUX)
+        pthread_cond_wait(static_cast<pthread_cond_t*>(m_pCondition),
+                          static_cast<pthread_mutex_t*>(mutex.m_pMutex));
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+void TCondition::wakeOne()
+{
+    #if defined(OS_WINDOWS)
+        if (m_Waiters > 0) {
+            --m_Waiters;
+            ReleaseSemaphore(m_pCondition, 1, NULL);
+        }
+    #elif defined(OS_LINUX)
+        pthread_cond_signal(static_cast<pthread_cond_t*>(m_pCondition));
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+
+void TCondition::wakeAll()
+{
+    #if defined(OS_WINDOWS)
+        if (m_Waiters > 0) {
+            ReleaseSemaphore(m_pCondition, static_cast<LONG>(m_Waiters), NULL);
+            m_Waiters = 0;
+        }
+    #elif defined(OS_LINUX)
+        pthread_cond_broadcast(static_cast<pthread_cond_t*>(m_pCondition));
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+TThreadPool::TThreadPool(TJob* pJob, size_t count)
+    : m_pJob(pJob),
+      m_Count(count),
+      m_Next(0),
+      m_Failed(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+bool TThreadPool::takeJob(size_t* pIndex)
+{
+    TMutexLocker Locker(m_Mutex);
+    if (m_Failed || m_Next >= m_Count)
+        return false;
+    *pIndex = m_Next++;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void TThreadPool::work()
+{
+    const bool WasInPool = InPool;
+    InPool = true;
+    size_t Index = 0;
+    while (takeJob(&Index)) {
+        if (!m_pJob->run(Index)) {
+            TMutexLocker Locker(m_Mutex);
+            m_Failed = true;
+        }
+    }
+    InPool = WasInPool;
+}
+
+//------------------------------------------------------------------------------
+
+#if defined(OS_WINDOWS)
+unsigned int __stdcall TThreadPool::threadFunc(void* pPool)
+{
+    static_cast<TThreadPool*>(pPool)->work();
+    return 0;
+}
+#else
+void* TThreadPool::threadFunc(void* pPool)
+{
+    static_cast<TThreadPool*>(pPool)->work();
+    return NULL;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// If some threads can't be created, jobs are done by the rest of threads.
+
+bool TThreadPool::run(TJob* pJob, size_t count, unsigned int threadCount)
+{
+    TThreadPool Pool(pJob, count);
+    if (threadCount > count)
+        threadCount = static_cast<unsigned int>(count);
+    if (InPool)
+        threadCount = 1;
+
+    #if defined(OS_WINDOWS)
+        vector<HANDLE> Threads;
+        for (unsigned int i = 1; i < threadCount; ++i) {
+            const uintptr_t Thread = _beginthreadex(NULL, 0, threadFunc, &Pool, 0, NULL);
+            if (Thread == 0) {
+                LOG_V("Can't create thread. Error %i.\n", errno);
+                break;
+            }
+            Threads.push_back(reinterpret_cast<HANDLE>(Thread));
+        }
+        Pool.work();
+        for (size_t i = 0; i < Threads.size(); ++i) {
+            WaitForSingleObject(Threads[i], INFINITE);
+            CloseHandle(Threads[i]);
+        }
+    #elif defined(OS_LINUX)
+        vector<pthread_t> Threads;
+        for (unsigned int i = 1; i < threadCount; ++i) {
+            pthread_t Thread;
+            const int Error = pthread_create(&Thread, NULL, threadFunc, &Pool);
+            if (Error != 0) {
+                LOG_V("Can't create thread. Error %i.\n", Error);
+                break;
+            }
+            Threads.push_back(Thread);
+        }
+        Pool.work();
+        for (size_t i = 0; i < Threads.size(); ++i)
+            pthread_join(Threads[i], NULL);
+    #else
+        #error "Unsupported OS."
+    #endif
+
+    return !Pool.m_Failed && Pool.m_Next >= Pool.m_Count;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned int TThreadPool::processorCount()
+{
+    #if defined(OS_WINDOWS)
+        SYSTEM_INFO Info;
+        GetSystemInfo(&Info);
+        return Info.dwNumberOfProcessors > 0 ? Info.dwNumberOfProcessors : 1;
+    #elif defined(OS_LINUX)
+        const long Count = sysconf(_SC_NPROCESSORS_ONLN);
+        return Count > 0 ? static_cast<unsigned int>(Count) : 1;
+    #else
+        #error "Unsupported OS."
+    #endif
+}
+
+//------------------------------------------------------------------------------
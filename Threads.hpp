@@ -0,0 +1,138 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+#ifndef __QTBINPATCHER2_THREADS__
+#define __QTBINPATCHER2_THREADS__
+
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+
+class TMutex
+{
+    friend class TCondition;
+
+    private :
+        void* m_pMutex;
+
+        TMutex(const TMutex&);
+        TMutex& operator=(const TMutex&);
+
+    public :
+        TMutex();
+        ~TMutex();
+
+        void lock();
+        void unlock();
+};
+
+//------------------------------------------------------------------------------
+
+class TMutexLocker
+{
+    private :
+        TMutex& m_Mutex;
+
+        TMutexLocker(const TMutexLocker&);
+        TMutexLocker& operator=(const TMutexLocker&);
+
+    public :
+        inline explicit TMutexLocker(TMutex& mutex) : m_Mutex(mutex)
+            { m_Mutex.lock(); }
+        inline ~TMutexLocker()
+            { m_Mutex.unlock(); }
+};
+
+//------------------------------------------------------------------------------
+// Condition variable. wait() and wake functions are called with mutex locked.
+// Waiting can end without wake, so condition must be checked in loop.
+
+class TCondition
+{
+    private :
+        void*  m_pCondition;
+        #if defined(OS_WINDOWS)
+            size_t m_Waiters;
+        #endif
+
+        TCondition(const TCondition&);
+        TCondition& operator=(const TCondition&);
+
+    public :
+        TCondition();
+        ~TCondition();
+
+        void wait(TMutex& mutex);
+        void wakeOne();
+        void wakeAll();
+};
+
+//------------------------------------------------------------------------------
+// Running of numbered jobs in several threads (calling thread is one of them).
+// Jobs are started in order of their numbers. After the first failed job
+// new jobs are not started. Pool run from a job of other pool uses only the
+// calling thread, so nested pools don't multiply threads.
+
+class TThreadPool
+{
+    public :
+        class TJob {
+            public :
+                virtual ~TJob() {}
+                virtual bool run(size_t index) = 0;
+        };
+
+    private :
+        TJob*  m_pJob;
+        size_t m_Count;
+        size_t m_Next;
+        bool   m_Failed;
+        TMutex m_Mutex;
+
+        TThreadPool(TJob* pJob, size_t count);
+        bool takeJob(size_t* pIndex);
+        void work();
+        #if defined(OS_WINDOWS)
+            static unsigned int __stdcall threadFunc(void* pPool);
+        #else
+            static void* threadFunc(void* pPool);
+        #endif
+
+    public :
+        static bool run(TJob* pJob, size_t count, unsigned int threadCount);
+        static unsigned int processorCount();
+};
+
+//------------------------------------------------------------------------------
+
+#endif // __QTBINPATCHER2_THREADS__
@@ -57,7 +57,39 @@ void howToUseMessage()
         "                 This option incompatible with option \"--backup\".\n"
         "                 WARNING: If an error occurs during patching, Qt library can be\n"
         "                          permanently damaged!\n"
+        "  --backup-archive=name\n"
+        "                 Store originals of patched files in one archive file \"name\"\n"
+        "                 instead of \".bak\" files. Identical files are stored once.\n"
+        "                 The archive is kept with option \"--backup\".\n"
+        "  --backup-journal=name\n"
+        "                 Don't copy patched files, but write original content of their\n"
+        "                 changed parts into journal file \"name\" before changing them.\n"
+        "                 The journal is kept with option \"--backup\". This option\n"
+        "                 incompatible with option \"--backup-archive\".\n"
+        "  --backup-memory=N\n"
+        "                 Keep originals of patched files in memory up to N bytes\n"
+        "                 (suffixes K, M and G may be used). Files, which don't fit,\n"
+        "                 are backed up on disk. Originals kept in memory are lost if\n"
+        "                 process is killed.\n"
+        "  --resume       Finish run, which was interrupted (process was killed).\n"
+        "                 Files done by it are not patched again. Other options must be\n"
+        "                 the same as in interrupted run; backup options are taken from\n"
+        "                 its checkpoint.\n"
+        "  --rollback     Restore files changed by interrupted run from its backup.\n"
+        "  --restore-archive=name\n"
+        "                 Restore all files stored in archive \"name\" (kept by run with\n"
+        "                 options \"--backup-archive\" and \"--backup\") and exit.\n"
+        "  --shadow-tree  Patch copies of files in shadow tree near Qt directory (other\n"
+        "                 files are hard links) and replace Qt directory by it at once.\n"
+        "                 With option \"--backup\" the old tree is kept with suffix\n"
+        "                 \".bak\". This option incompatible with options \"--atomic\",\n"
+        "                 \"--backup-archive\" and \"--backup-journal\".\n"
         "  --force        Force patching (without old path actuality checking).\n"
+        "  --atomic       Write patched text files into temporary files and rename them\n"
+        "                 over the originals. Original files are kept as backup by hard\n"
+        "                 links instead of copies.\n"
+        "  --jobs=N       Patch up to N files at once (1 by default). If N is 0, the\n"
+        "                 number of processors is used.\n"
         "  --qt-dir=path  Directory, where Qt or qmake is now located (may be relative).\n"
         "                 If not specified, will be used current directory. Patcher will\n"
         "                 search qmake first in directory \"path\", and then in its subdir\n"
@@ -73,6 +105,9 @@ void howToUseMessage()
         "  If missing \"--backup\" and \"--nobackup\" options, the backup files will be\n"
         "  created before patching and deleted after successful completion of the\n"
         "  patching or restored if an error occurs.\n"
+        "  Progress of patching is written into file \".qtbpcheckpoint\" in Qt\n"
+        "  directory. The file is left only if process was killed; then the run can\n"
+        "  be resumed or rolled back.\n"
         "\n"
         //.......|.........|.........|.........|.........|.........|.........|.........|
     );
@@ -0,0 +1,148 @@
+/*******************************************************************************
+
+         Yuri V. Krugloff. 2013-2015. http://www.tver-soft.org
+
+    This is free and unencumbered software released into the public domain.
+
+    Anyone is free to copy, modify, publish, use, compile, sell, or
+    distribute this software, either in source code form or as a compiled
+    binary, for any purpose, commercial or non-commercial, and by any
+    means.
+
+    In jurisdictions that recognize copyright laws, the author or authors
+    of this software dedicate any and all copyright interest in the
+    software to the public domain. We make this dedication for the benefit
+    of the public at large and to the detriment of our heirs and
+    successors. We intend this dedication to be an overt act of
+    relinquishment in perpetuity of all present and future rights to this
+    software under copyright law.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+    OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+    ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+    OTHER DEALINGS IN THE SOFTWARE.
+
+    For more information, please refer to <http://unlicense.org/>
+
+*******************************************************************************/
+
+//------------------------------------------------------------------------------
+// Test of TPeFile on fixtures made by "data/mkpe.py". Usage:
+//     PeFileTest <directory with fixtures>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../PeFile.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+struct TExpectedRange {
+    size_t      Offset;
+    size_t      Size;
+    const char* Key;
+};
+
+//------------------------------------------------------------------------------
+
+static int Errors = 0;
+
+//------------------------------------------------------------------------------
+
+static void check(bool condition, const string& fixture, const char* message)
+{
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", fixture.c_str(), message);
+        ++Errors;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static bool readFixture(const string& fileName, vector<char>* pData)
+{
+    FILE* File = fopen(fileName.c_str(), "rb");
+    if (File == NULL) {
+        fprintf(stderr, "Can't open fixture \"%s\".\n", fileName.c_str());
+        return false;
+    }
+    char Buf[4096];
+    size_t Count;
+    while ((Count = fread(Buf, 1, sizeof(Buf), File)) > 0)
+        pData->insert(pData->end(), Buf, Buf + Count);
+    fclose(File);
+    return !pData->empty();
+}
+
+//------------------------------------------------------------------------------
+// Only data sections are returned: code, uninitialized data and debug
+// sections are skipped, padding behind virtual size is cut off.
+
+static void testFixture(const string& dir, const char* name, const TExpectedRange* expected, size_t count)
+{
+    const string Fixture = dir + "/" + name;
+    vector<char> Data;
+    if (!readFixture(Fixture, &Data)) {
+        ++Errors;
+        return;
+    }
+
+    check(TPeFile::isPe(Data.data(), Data.size()), Fixture, "not recognized as PE");
+    TPeFile File(Data.data(), Data.size());
+    check(File.hasSections(), Fixture, "no sections");
+
+    TFileRanges Ranges;
+    check(File.getDataRanges(&Ranges), Fixture, "no data ranges");
+    check(Ranges.size() == count, Fixture, "wrong number of data ranges");
+    for (size_t i = 0; i < Ranges.size() && i < count; ++i) {
+        check(Ranges[i].Offset == expected[i].Offset && Ranges[i].Size == expected[i].Size,
+              Fixture, "wrong data range");
+        check(memcmp(Data.data() + Ranges[i].Offset, expected[i].Key, strlen(expected[i].Key)) == 0,
+              Fixture, "data range doesn't start with slot");
+    }
+
+    // Broken files: truncated section table and missing PE header.
+    TFileRanges Broken;
+    check(!TPeFile(Data.data(), 0x200).getDataRanges(&Broken) && Broken.empty(),
+          Fixture, "truncated section table is accepted");
+    Data[0x80] = 'X';
+    check(!TPeFile::isPe(Data.data(), Data.size()), Fixture, "file without PE signature is accepted");
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <directory with fixtures>\n", argv[0]);
+        return 2;
+    }
+
+    static const TExpectedRange Pe32[] = {
+        { 0x600, 0x300, "qt_prfxpath=" },
+        { 0xA00, 524,   "qt_binspath=" }
+    };
+    testFixture(argv[1], "pe32.dll", Pe32, sizeof(Pe32)/sizeof(Pe32[0]));
+
+    static const TExpectedRange Pe32Plus[] = {
+        { 0x600,  0x300, "qt_prfxpath=" },
+        { 0xA00,  0x300, "qt_hpfxpath=" },
+        { 0x1200, 0x300, "qt_binspath=" }
+    };
+    testFixture(argv[1], "pe32plus.dll", Pe32Plus, sizeof(Pe32Plus)/sizeof(Pe32Plus[0]));
+
+    if (Errors == 0)
+        printf("All PE tests passed.\n");
+    return Errors == 0 ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Generator of PE fixtures for PeFileTest. Usage: mkpe.py <output dir>
+
+import struct
+import sys
+
+FILE_ALIGNMENT = 0x200
+
+TEXT  = 0x60000020
+RDATA = 0x40000040
+DATA  = 0xC0000040
+BSS   = 0xC0000080
+DEBUG = 0x42000040
+
+
+def slot(value, size=524):
+    return value.encode() + b'\0' * (size - len(value))
+
+
+def align(size):
+    return (size + FILE_ALIGNMENT - 1) // FILE_ALIGNMENT * FILE_ALIGNMENT
+
+
+# Sections are tuples (name, virtual size, data, flags); data of
+# uninitialized section is None.
+def pe(plus, sections, strtab=b''):
+    opt_size = 240 if plus else 224
+    dos = bytearray(0x80)
+    dos[0:2] = b'MZ'
+    struct.pack_into('<I', dos, 0x3C, len(dos))
+    raw = align(len(dos) + 4 + 20 + opt_size + 40 * len(sections))
+
+    headers = b''
+    body = b''
+    rva = 0x1000
+    for name, vsize, data, flags in sections:
+        if data is None:
+            headers += struct.pack('<8sIIIIIIHHI', name, vsize, rva, 0, 0, 0, 0, 0, 0, flags)
+        else:
+            size = align(len(data))
+            headers += struct.pack('<8sIIIIIIHHI', name, vsize, rva, size, raw + len(body), 0, 0, 0, 0, flags)
+            body += data + b'\0' * (size - len(data))
+        rva += 0x1000
+
+    symtab = raw + len(body) if strtab else 0
+    coff = struct.pack('<HHIIIHH', 0x8664 if plus else 0x14C, len(sections), 0, symtab, 0, opt_size, 0x2022)
+    opt = bytearray(opt_size)
+    struct.pack_into('<HxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxII', opt, 0, 0x20B if plus else 0x10B, 0x1000, FILE_ALIGNMENT)
+
+    image = dos + b'PE\0\0' + coff + opt + headers
+    image += b'\0' * (raw - len(image)) + body
+    if strtab:
+        image += struct.pack('<I', 4 + len(strtab)) + strtab
+    return bytes(image)
+
+
+# PE32: key in code, slot in ".rdata", slot in ".data" with virtual size
+# shorter than raw size and key in padding behind it, ".bss".
+pe32 = pe(False, [
+    (b'.text',  0x100, b'\x90' * 16 + b'qt_docspath=C:/decoy', TEXT),
+    (b'.rdata', 0x300, slot('qt_prfxpath=C:/old/qt'), RDATA),
+    (b'.data',  524,   slot('qt_binspath=C:/old/qt/bin') + b'qt_libspath=C:/old/qt/lib', DATA),
+    (b'.bss',   0x100, None, BSS),
+])
+
+# PE32+: long names of sections (as MinGW writes them) in COFF string table.
+pe32plus = pe(True, [
+    (b'.text',  0x100, b'\x90' * 16 + b'qt_docspath=C:/decoy', TEXT),
+    (b'.rdata', 0x300, slot('qt_prfxpath=C:/old/qt'), RDATA),
+    (b'/4',     0x300, slot('qt_hpfxpath=C:/old/qt'), RDATA),
+    (b'/15',    0x100, slot('qt_plugpath=C:/debug'), DEBUG),
+    (b'.data',  0x300, slot('qt_binspath=C:/old/qt/bin'), DATA),
+], b'.rdata$zzz\0.debug_info\0')
+
+with open(sys.argv[1] + '/pe32.dll', 'wb') as f:
+    f.write(pe32)
+with open(sys.argv[1] + '/pe32plus.dll', 'wb') as f:
+    f.write(pe32plus)